@@ -0,0 +1,357 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <QDebug>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "recording.hh"
+#include "processor.hh"
+#include "calibration.hh"
+#include "rederive.hh"
+#include "recovery.hh"
+
+
+/** Derived values of a single sample. */
+struct DerivedSample
+{
+  float spo2;
+  float spo2Std;
+  float pulse;
+  float pulseStd;
+  /** Fixed-lag smoothed SpO2 and pulse rate trends. */
+  float spo2Smooth;
+  float pulseSmooth;
+  float respiration;
+  float quality;
+  bool  valid;
+  bool  beat;
+};
+
+
+/** Re-derives all values of a raw log and writes them into the output directory. */
+static bool
+rederive(const QString &filename, const QDir &outdir, const CalibrationCurve &curve,
+         bool medianDC)
+{
+  RawLogReader log;
+  if (! log.open(filename))
+    return false;
+  QFileInfo info(filename);
+  QFile file(outdir.filePath(info.completeBaseName() + ".rederived.tsv"));
+  if (! file.open(QIODevice::WriteOnly)) {
+    qDebug() << "Cannot write" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  QTextStream out(&file);
+  out << "#T\tBASE\tIR\tRED\tFLAGS\tQUALITY\tSpO2\tPULSE\tIR_MEAN\tIR_PULSE\tIR_STD"
+         "\tRED_MEAN\tRED_PULSE\tRED_STD\tRATIO\tLOST\n";
+  Rederivation derivation(log.header().period, curve, medianDC);
+  QVector<RawLogReader::Sample> samples(RawLogWriter::indexInterval);
+  uint16_t seq = 0xffff;
+  for (size_t i=0, n; 0 != (n = log.read(i, samples.size(), samples.data())); i+=n) {
+    for (size_t j=0; j<n; j++) {
+      const RawLogReader::Sample &sample = samples[j];
+      const BinaryLogRecord &rec = derivation.update(sample.t, sample.base, sample.ir, sample.red);
+      out << rec.t << "\t" << rec.base << "\t" << rec.ir << "\t" << rec.red << "\t"
+          << int(rec.flags) << "\t" << int(rec.quality) << "\t"
+          << rec.spo2 << "\t" << rec.pulse << "\t"
+          << rec.irMean << "\t" << rec.irPulse << "\t" << rec.irStd << "\t"
+          << rec.redMean << "\t" << rec.redPulse << "\t" << rec.redStd << "\t"
+          << rec.ratio << "\t" << uint16_t(sample.seq-seq-1) << "\n";
+      seq = sample.seq;
+    }
+  }
+  return true;
+}
+
+/** Parses a time given in minutes since the start of a recording or as date and time (ISO 8601),
+ * into ms since the start of the recording. */
+static bool
+parseTime(const QString &value, int64_t startTime, uint32_t &t) {
+  bool ok;
+  double ms = value.toDouble(&ok)*60e3;
+  if (! ok) {
+    QDateTime time = QDateTime::fromString(value, Qt::ISODate);
+    if ((! time.isValid()) || (0 == startTime))
+      return false;
+    ms = time.toMSecsSinceEpoch() - startTime;
+  }
+  t = std::min(double(std::numeric_limits<uint32_t>::max()), std::max(0., ms));
+  return true;
+}
+
+/** Analyzes the samples of a single recording within [from, to) ms, writes the derived series
+ * into the output directory and the summary statistics into @c summaryRow.
+ *
+ * The samples are processed in order by a single processor, like in the live application. Several
+ * stages carry state over arbitrary spans of the recording (e.g., the trend trackers, the beat
+ * template and the sign of the respiratory signal), hence chunks of a recording processed
+ * independently after a warm-up would not reproduce a sequential run. Instead, several recordings
+ * get analyzed in parallel (see @c AnalysisTask). */
+static bool
+analyze(const QString &filename, const QDir &outdir, QString &summaryRow, uint16_t period,
+        uint32_t from, uint32_t to, const CalibrationCurve &curve, bool medianDC)
+{
+  Recording recording;
+  if (! readRecording(filename, period, recording, from, to))
+    return false;
+  size_t N = recording.samples.size();
+  QVector<DerivedSample> derived(N);
+  QVector<BeatFeatures> beatFeatures;
+
+  Processor proc(recording.period);
+  proc.setMedianDC(medianDC);
+  size_t lag = proc.pulseTracker().lag();
+  for (size_t i=0; i<N; i++) {
+    const RawSample &sample = recording.samples[i];
+    bool beat;
+    if (recording.hasBase)
+      beat = proc.update(sample.t, sample.base, sample.ir, sample.red);
+    else
+      beat = proc.update(sample.t, sample.ir, sample.red);
+    double ratio = proc.ratio(), ratioStd = proc.ratioStd();
+    DerivedSample &res = derived[i];
+    res.spo2        = curve.eval(ratio);
+    res.spo2Std     = std::abs(curve.eval(ratio-ratioStd)-curve.eval(ratio+ratioStd))/2;
+    res.pulse       = proc.pulse();
+    res.pulseStd    = proc.pulseStd();
+    // near the end of the recording, the filtered trend is the best available estimate
+    res.spo2Smooth  = res.spo2;
+    res.pulseSmooth = res.pulse;
+    res.respiration = proc.respirationRate();
+    res.quality     = proc.quality();
+    res.valid       = proc.isValid();
+    res.beat        = beat;
+    if (res.valid && proc.hasBeatFeatures())
+      beatFeatures.append(proc.beatFeatures());
+    // smoothed trends of the sample lag steps ago
+    if (i >= lag) {
+      DerivedSample &past = derived[i-lag];
+      past.spo2Smooth  = curve.eval(proc.ratioTracker().smoothedValue());
+      past.pulseSmooth = proc.pulseTracker().smoothedValue();
+    }
+  }
+
+  // Write derived series
+  QFileInfo info(filename);
+  QFile file(outdir.filePath(info.completeBaseName() + ".derived.tsv"));
+  if (! file.open(QIODevice::WriteOnly)) {
+    qDebug() << "Cannot write" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  QTextStream series(&file);
+  series << "#T\tSpO2\tSpO2_SD\tSpO2_SMOOTH\tPULSE\tPULSE_SD\tPULSE_SMOOTH\tRESP\tQUALITY"
+            "\tVALID\tBEAT\n";
+  size_t valid = 0, beats = 0;
+  double sumSpO2 = 0, sumPulse = 0, sumResp = 0;
+  double minSpO2 = 100, minPulse = 1e3, maxPulse = 0;
+  for (size_t i=0; i<N; i++) {
+    const DerivedSample &res = derived[i];
+    series << recording.samples[i].t << "\t" << res.spo2 << "\t" << res.spo2Std << "\t"
+           << res.spo2Smooth << "\t" << res.pulse << "\t" << res.pulseStd << "\t"
+           << res.pulseSmooth << "\t" << res.respiration << "\t" << res.quality << "\t" << int(res.valid) << "\t"
+           << int(res.beat) << "\n";
+    if (! res.valid)
+      continue;
+    valid++;
+    beats += res.beat;
+    sumSpO2 += res.spo2; sumPulse += res.pulse; sumResp += res.respiration;
+    minSpO2  = std::min(minSpO2, double(res.spo2));
+    minPulse = std::min(minPulse, double(res.pulse));
+    maxPulse = std::max(maxPulse, double(res.pulse));
+  }
+
+  // Write beat features
+  QFile beatFile(outdir.filePath(info.completeBaseName() + ".beats.tsv"));
+  if (! beatFile.open(QIODevice::WriteOnly)) {
+    qDebug() << "Cannot write" << beatFile.fileName() << ":" << beatFile.errorString();
+    return false;
+  }
+  QTextStream beatStream(&beatFile);
+  beatStream << "#T\tINTERVAL\tPI\tRISE\tNOTCH_T\tNOTCH_H\tAPG_A\tAPG_B\tAPG_C\tAPG_D\tAPG_E\n";
+  foreach (const BeatFeatures &beat, beatFeatures) {
+    beatStream << beat.t << "\t" << beat.interval << "\t" << beat.perfusion << "\t"
+               << beat.riseTime << "\t" << beat.notchTime << "\t" << beat.notchHeight;
+    for (int j=0; j<5; j++)
+      beatStream << "\t" << beat.apg[j];
+    beatStream << "\n";
+  }
+
+  // Write summary
+  QTextStream summary(&summaryRow);
+  double duration = N ? (recording.samples.last().t - recording.samples.first().t) : 0;
+  summary << info.fileName() << "\t" << N << "\t" << duration << "\t"
+          << (N ? double(valid)/N : 0) << "\t" << beats << "\t";
+  if (valid) {
+    summary << sumSpO2/valid << "\t" << minSpO2 << "\t" << sumPulse/valid << "\t"
+            << minPulse << "\t" << maxPulse << "\t" << sumResp/valid << "\n";
+  } else {
+    summary << "nan\tnan\tnan\tnan\tnan\tnan\n";
+  }
+  return true;
+}
+
+
+/** Analyzes a single recording on the thread pool, optionally recovering it before and
+ * re-deriving its raw samples after the analysis. */
+class AnalysisTask: public QRunnable
+{
+public:
+  AnalysisTask(const QString &filename, const QDir &outdir, uint16_t period, const QString &from,
+               const QString &to, bool recover, bool rederive, const CalibrationCurve &curve,
+               bool medianDC, QString *summaryRow, bool *ok)
+    : QRunnable(), _filename(filename), _outdir(outdir), _period(period), _from(from), _to(to),
+      _recover(recover), _rederive(rederive), _curve(curve), _medianDC(medianDC),
+      _summaryRow(summaryRow), _ok(ok)
+  {
+    // pass...
+  }
+
+  void run() {
+    *_ok = false;
+    if (_recover && (! recoverRecording(_filename)))
+      return;
+    // Time window, the binary formats seek to it without reading the preceding samples
+    uint32_t from = 0, to = std::numeric_limits<uint32_t>::max();
+    if ((! _from.isEmpty()) || (! _to.isEmpty())) {
+      int64_t startTime = recordingStartTime(_filename);
+      if (((! _from.isEmpty()) && (! parseTime(_from, startTime, from))) ||
+          ((! _to.isEmpty()) && (! parseTime(_to, startTime, to)))) {
+        qDebug() << "Invalid time window for" << _filename;
+        return;
+      }
+    }
+    if (! analyze(_filename, _outdir, *_summaryRow, _period, from, to, _curve, _medianDC))
+      return;
+    if (_rederive && RawLogReader::isRawLog(_filename) &&
+        (! rederive(_filename, _outdir, _curve, _medianDC)))
+      return;
+    *_ok = true;
+  }
+
+protected:
+  QString _filename;
+  QDir _outdir;
+  uint16_t _period;
+  QString _from, _to;
+  bool _recover, _rederive;
+  const CalibrationCurve &_curve;
+  bool _medianDC;
+  QString *_summaryRow;
+  bool *_ok;
+};
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("pulse-analyze");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Offline analysis of pulse oximeter recordings.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("recordings", "Recordings or directories containing recordings.");
+  QCommandLineOption outputOpt(QStringList() << "o" << "output",
+                               "Output directory (default: current directory).", "dir", ".");
+  QCommandLineOption jobsOpt(QStringList() << "j" << "jobs",
+                             "Number of threads (default: number of cores).", "n");
+  QCommandLineOption periodOpt("period", "Sample period of text logs in ms (default: 75).",
+                               "ms", "75");
+  QCommandLineOption calibOpt("calibration", "Calibration file.", "file");
+  QCommandLineOption medianOpt("median-dc", "Extract the DC components by running median "
+                               "filters instead of the sinc low-pass.");
+  QCommandLineOption serialOpt("serial", "Serial number of the device used for the recordings.",
+                               "serial");
+  parser.addOption(outputOpt);
+  parser.addOption(jobsOpt);
+  parser.addOption(periodOpt);
+  parser.addOption(calibOpt);
+  parser.addOption(medianOpt);
+  QCommandLineOption fromOpt("from", "Analyze the samples from the given time on, in minutes "
+                             "since the start of the recording or as date and time (ISO 8601).",
+                             "time");
+  QCommandLineOption toOpt("to", "Analyze the samples up to the given time.", "time");
+  QCommandLineOption rederiveOpt("rederive", "Also write all values re-derived from the raw "
+                                 "samples of raw logs (.praw).");
+  parser.addOption(serialOpt);
+  parser.addOption(fromOpt);
+  parser.addOption(toOpt);
+  QCommandLineOption recoverOpt("recover", "Truncate the recordings after their last complete "
+                                "record or block (e.g., after a crash) before the analysis.");
+  parser.addOption(rederiveOpt);
+  parser.addOption(recoverOpt);
+  parser.process(app);
+
+  if (parser.isSet(jobsOpt))
+    QThreadPool::globalInstance()->setMaxThreadCount(std::max(1, parser.value(jobsOpt).toInt()));
+
+  Calibration calibration;
+  if (parser.isSet(calibOpt) && (! calibration.load(parser.value(calibOpt))))
+    return 1;
+  const CalibrationCurve &curve = calibration.curve(parser.value(serialOpt));
+
+  // Collect recordings
+  QStringList files;
+  foreach (QString path, parser.positionalArguments()) {
+    QFileInfo info(path);
+    if (info.isDir()) {
+      QDir dir(path);
+      QStringList filters = QStringList() << "*.csv" << "*.txt" << "*.plog" << "*.pcol" << "*.praw";
+      foreach (QFileInfo entry, dir.entryInfoList(filters, QDir::Files, QDir::Name))
+        files.append(entry.filePath());
+    } else {
+      files.append(path);
+    }
+  }
+  if (files.isEmpty())
+    parser.showHelp(1);
+
+  QDir outdir(parser.value(outputOpt));
+  if ((! outdir.exists()) && (! outdir.mkpath("."))) {
+    qDebug() << "Cannot create output directory" << outdir.path();
+    return 1;
+  }
+  QFile summaryFile(outdir.filePath("summary.tsv"));
+  if (! summaryFile.open(QIODevice::WriteOnly)) {
+    qDebug() << "Cannot write" << summaryFile.fileName() << ":" << summaryFile.errorString();
+    return 1;
+  }
+  QTextStream summary(&summaryFile);
+  summary << "#FILE\tSAMPLES\tDURATION\tVALID\tBEATS\tSpO2_MEAN\tSpO2_MIN"
+             "\tPULSE_MEAN\tPULSE_MIN\tPULSE_MAX\tRESP_MEAN\n";
+
+  uint16_t period = parser.value(periodOpt).toUInt();
+  if (0 == period) {
+    qDebug() << "Invalid sample period" << parser.value(periodOpt);
+    return 1;
+  }
+  // Each recording is processed sequentially, the recordings in parallel
+  QVector<QString> rows(files.size());
+  QVector<bool> ok(files.size());
+  QThreadPool *pool = QThreadPool::globalInstance();
+  for (int i=0; i<files.size(); i++) {
+    pool->start(new AnalysisTask(files[i], outdir, period, parser.value(fromOpt),
+                                 parser.value(toOpt), parser.isSet(recoverOpt),
+                                 parser.isSet(rederiveOpt), curve, parser.isSet(medianOpt),
+                                 &rows[i], &ok[i]));
+  }
+  pool->waitForDone();
+
+  int failed = 0;
+  for (int i=0; i<files.size(); i++) {
+    if (ok[i])
+      summary << rows[i];
+    else
+      failed++;
+  }
+
+  return failed ? 1 : 0;
+}
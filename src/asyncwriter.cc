@@ -0,0 +1,188 @@
+#include "asyncwriter.hh"
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+
+AsyncWriter::AsyncWriter(int bufferSize, unsigned long flushInterval)
+  : _file(), _thread(*this), _bufferSize(bufferSize), _flushInterval(flushInterval),
+    _syncPolicy(SYNC_NEVER), _syncInterval(0), _mutex(), _pending(), _front(0),
+    _backPending(false), _stop(false), _stalled(false), _failed(false), _written(0), _dropped(0),
+    _stalls(0), _maxLatency(0)
+{
+  // reserved buffers keep their capacity when cleared
+  _buffers[0].reserve(_bufferSize);
+  _buffers[1].reserve(_bufferSize);
+}
+
+AsyncWriter::~AsyncWriter() {
+  close();
+}
+
+void
+AsyncWriter::setSyncPolicy(SyncPolicy policy, unsigned long interval) {
+  QMutexLocker lock(&_mutex);
+  _syncPolicy = policy;
+  _syncInterval = interval;
+}
+
+bool
+AsyncWriter::open(const QString &filename) {
+  close();
+  _file.setFileName(filename);
+  // The buffering is done here
+  if (! _file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+    qDebug() << "Cannot open" << filename << ":" << _file.errorString();
+    return false;
+  }
+  _buffers[0].resize(0);
+  _buffers[1].resize(0);
+  _writes[0] = _writes[1] = 0;
+  _front = 0;
+  _backPending = _stop = _stalled = _failed = false;
+  _written = _dropped = _stalls = 0;
+  _maxLatency = 0;
+  _thread.start(QThread::LowPriority);
+  return true;
+}
+
+bool
+AsyncWriter::isOpen() const {
+  return _file.isOpen();
+}
+
+QString
+AsyncWriter::fileName() const {
+  return _file.fileName();
+}
+
+void
+AsyncWriter::close() {
+  if (! _file.isOpen())
+    return;
+  _mutex.lock();
+  _stop = true;
+  _pending.wakeOne();
+  _mutex.unlock();
+  _thread.wait();
+  _file.close();
+}
+
+bool
+AsyncWriter::write(const char *data, int len) {
+  QMutexLocker lock(&_mutex);
+  QByteArray &front = _buffers[_front];
+  if ((front.size()+len) > _bufferSize) {
+    if (_backPending || (len > _bufferSize)) {
+      // The writer is still busy, drop the data
+      if (! _stalled)
+        _stalls++;
+      _stalled = true;
+      _dropped++;
+      return false;
+    }
+    _swap();
+  }
+  _buffers[_front].append(data, len);
+  _writes[_front]++;
+  _written += len;
+  _stalled = false;
+  return true;
+}
+
+bool
+AsyncWriter::write(const QByteArray &data) {
+  return write(data.constData(), data.size());
+}
+
+quint64
+AsyncWriter::written() const {
+  QMutexLocker lock(&_mutex);
+  return _written;
+}
+
+quint64
+AsyncWriter::dropped() const {
+  QMutexLocker lock(&_mutex);
+  return _dropped;
+}
+
+bool
+AsyncWriter::failed() const {
+  QMutexLocker lock(&_mutex);
+  return _failed;
+}
+
+quint64
+AsyncWriter::stalls() const {
+  QMutexLocker lock(&_mutex);
+  return _stalls;
+}
+
+qint64
+AsyncWriter::maxLatency() const {
+  QMutexLocker lock(&_mutex);
+  return _maxLatency;
+}
+
+void
+AsyncWriter::_swap() {
+  _front = 1-_front;
+  _backPending = true;
+  _pending.wakeOne();
+}
+
+void
+AsyncWriter::_run() {
+  QElapsedTimer lastSync; lastSync.start();
+  QMutexLocker lock(&_mutex);
+  while (true) {
+    if ((! _backPending) && (! _stop))
+      _pending.wait(&_mutex, _flushInterval);
+    // On timeout or stop, hand over the data held in the front buffer
+    if ((! _backPending) && _buffers[_front].size())
+      _swap();
+    if (! _backPending) {
+      if (_stop)
+        break;
+      continue;
+    }
+
+    // Write back buffer without holding the lock
+    QByteArray &back = _buffers[1-_front];
+    bool sync = (SYNC_BUFFER == _syncPolicy) ||
+        ((SYNC_PERIODIC == _syncPolicy) && (lastSync.elapsed() >= qint64(_syncInterval)));
+    lock.unlock();
+    QElapsedTimer timer; timer.start();
+    qint64 pos = _file.pos();
+    bool failed = (back.size() != _file.write(back));
+    if (failed) {
+      qDebug() << "Cannot write" << _file.fileName() << ":" << _file.errorString();
+      // Drop the buffer as a whole, truncating any partially written record
+      _file.resize(pos);
+      _file.seek(pos);
+    }
+#ifdef Q_OS_UNIX
+    if (sync) {
+      ::fsync(_file.handle());
+      lastSync.restart();
+    }
+#endif
+    qint64 latency = timer.elapsed();
+    lock.relock();
+
+    if (failed) {
+      _dropped += _writes[1-_front];
+      _written -= back.size();
+      _failed = true;
+    }
+    back.resize(0);
+    _writes[1-_front] = 0;
+    _backPending = false;
+    _maxLatency = std::max(_maxLatency, latency);
+  }
+}
@@ -0,0 +1,134 @@
+#ifndef ASYNCWRITER_HH
+#define ASYNCWRITER_HH
+
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+
+
+/** Double-buffered file writer running in a background thread.
+ *
+ * The producer (e.g., the acquisition) appends data to the front buffer, which never blocks on
+ * the disk. Once the front buffer is full or the flush interval has passed, it gets swapped with
+ * the back buffer, which the writer thread writes to the file in a single sequential write. If
+ * the writer thread is still busy with the back buffer when the front buffer is full (i.e., the
+ * disk is too slow), further writes get dropped and counted, rather than stalling the producer.
+ * Each write is either stored completely or dropped, hence records are never torn. If writing a
+ * buffer to the file fails (e.g., the disk is full), the buffer is dropped as a whole: its writes
+ * are counted as dropped and a partially written buffer gets truncated. Syncing once per buffer
+ * commits all records in it as a group, which amortizes the cost of the sync. */
+class AsyncWriter
+{
+public:
+  /** Possible policies to sync the file to the disk. */
+  typedef enum {
+    SYNC_NEVER,    ///< Leave it to the OS.
+    SYNC_BUFFER,   ///< Sync after each buffer written.
+    SYNC_PERIODIC  ///< Sync after a buffer, if the sync interval has passed since the last sync.
+  } SyncPolicy;
+
+public:
+  /** Constructor.
+   * @param bufferSize Specifies the size of each buffer in bytes.
+   * @param flushInterval Specifies the maximum time in ms, data is held in the front buffer. */
+  AsyncWriter(int bufferSize=(1<<16), unsigned long flushInterval=1000);
+  /** Destructor, closes the file. */
+  ~AsyncWriter();
+
+  /** Sets the sync policy, @c interval specifies the sync interval in ms for @c SYNC_PERIODIC. */
+  void setSyncPolicy(SyncPolicy policy, unsigned long interval=0);
+
+  /** Opens (truncates) the given file and starts the writer thread. Returns @c false on error. */
+  bool open(const QString &filename);
+  /** Returns @c true if a file is open. */
+  bool isOpen() const;
+  /** Returns the name of the file. */
+  QString fileName() const;
+  /** Writes all pending data and closes the file. */
+  void close();
+
+  /** Appends the given data. Returns @c false if the data got dropped. */
+  bool write(const char *data, int len);
+  /** Appends the given data. Returns @c false if the data got dropped. */
+  bool write(const QByteArray &data);
+
+  /** Returns the number of bytes accepted (i.e., not dropped) since the file was opened. */
+  quint64 written() const;
+  /** Returns the number of writes dropped, including the writes of buffers the file could not
+   * take. */
+  quint64 dropped() const;
+  /** Returns @c true if writing to the file failed since it was opened. */
+  bool failed() const;
+  /** Returns the number of times the front buffer filled up while the writer was still busy, i.e.,
+   * the number of back-pressure events. */
+  quint64 stalls() const;
+  /** Returns the longest duration of writing and syncing a buffer in ms. */
+  qint64 maxLatency() const;
+
+protected:
+  /** Main loop of the writer thread. */
+  void _run();
+  /** Hands the front buffer over to the writer thread, the mutex must be held. */
+  void _swap();
+
+protected:
+  /** The writer thread. */
+  class Thread: public QThread
+  {
+  public:
+    Thread(AsyncWriter &writer)
+      : QThread(), _writer(writer)
+    {
+      // pass...
+    }
+
+  protected:
+    void run() {
+      _writer._run();
+    }
+
+  protected:
+    AsyncWriter &_writer;
+  };
+
+private:
+  // Not copyable
+  AsyncWriter(const AsyncWriter &other);
+  AsyncWriter &operator=(const AsyncWriter &other);
+
+protected:
+  QFile _file;
+  Thread _thread;
+  int _bufferSize;
+  unsigned long _flushInterval;
+  SyncPolicy _syncPolicy;
+  unsigned long _syncInterval;
+
+  /** Protects the buffers and the state below. */
+  mutable QMutex _mutex;
+  /** Signals the writer thread that a buffer is pending or the writer should stop. */
+  QWaitCondition _pending;
+  /** Front and back buffer. */
+  QByteArray _buffers[2];
+  /** Number of writes in the front and back buffer. */
+  quint64 _writes[2];
+  /** Index of the front buffer. */
+  int _front;
+  /** If @c true, the back buffer is pending or being written. */
+  bool _backPending;
+  /** If @c true, the writer thread stops once all data is written. */
+  bool _stop;
+  /** If @c true, the last write got dropped. */
+  bool _stalled;
+  /** If @c true, writing a buffer to the file failed. */
+  bool _failed;
+
+  quint64 _written;
+  quint64 _dropped;
+  quint64 _stalls;
+  qint64 _maxLatency;
+};
+
+#endif // ASYNCWRITER_HH
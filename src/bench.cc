@@ -0,0 +1,85 @@
+/* Benchmark of the DC (baseline) filters.
+ *
+ * Compares the sinc low-pass with the running median and percentile filters across window
+ * lengths, with respect to the processing time per sample and the deviation from the true
+ * baseline of a synthetic pulse signal with spikes (motion artifacts). */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <chrono>
+
+#include "fir.hh"
+#include "median.hh"
+
+/// Number of samples processed per filter
+#define SAMPLES  (1<<20)
+/// Probability of a spike per sample
+#define SPIKE_P  0.01
+/// Sample period in ms
+#define PERIOD   75
+
+
+/** Synthetic test signal, a slowly drifting baseline plus a pulse wave and sparse spikes. */
+struct TestSignal
+{
+  std::vector<float> baseline;
+  std::vector<float> signal;
+
+  TestSignal(size_t n)
+    : baseline(n), signal(n)
+  {
+    srand(42);
+    for (size_t i=0; i<n; i++) {
+      double t = double(i*PERIOD)/60e3;
+      baseline[i] = 0.5 + 0.05*std::sin(2*M_PI*0.5*t);
+      signal[i]   = baseline[i] + 0.01*std::sin(2*M_PI*72*t);
+      if ((double(rand())/RAND_MAX) < SPIKE_P)
+        signal[i] += 0.2*(double(rand())/RAND_MAX - 0.5);
+    }
+  }
+};
+
+
+/** Runs the given filter over the test signal, prints the time per sample and the RMS error
+ * with respect to the baseline (compensating the filter delay of @c size/2 samples). */
+template <class F>
+static void
+run(const char *name, F filter, const TestSignal &test) {
+  size_t n = test.signal.size(), delay = F::size/2;
+  std::vector<float> out(n);
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for (size_t i=0; i<n; i++)
+    out[i] = filter.apply(test.signal[i]);
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end-start).count()/n;
+
+  // skip the start-up of the filter
+  double err = 0; size_t m = 0;
+  for (size_t i=F::size; i<n; i++, m++)
+    err += std::pow(out[i]-test.baseline[i-delay], 2);
+  printf("%-12s %6d %10.2f %12.3e\n", name, int(F::size), ns, std::sqrt(err/m));
+}
+
+template <uint16_t size>
+static void
+runAll(const TestSignal &test) {
+  // cut-off at 15/min, like the DC filters of the processor
+  run("lowpass",  FIR< LowPassKernel<size> >(LowPassKernel<size>(float(PERIOD*15)/60e3)), test);
+  run("median",   RunningMedian<size>(), test);
+  run("p25",      RunningPercentile<size>(0.25), test);
+}
+
+
+int main(int argc, char *argv[])
+{
+  TestSignal test(SAMPLES);
+  printf("#FILTER      WINDOW    NS/SAMPLE    RMS_ERROR\n");
+  runAll<16>(test);
+  runAll<32>(test);
+  runAll<64>(test);
+  runAll<128>(test);
+  runAll<256>(test);
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include "binarylog.hh"
+#include <QtGlobal>
+#include <QDebug>
+#include <cstring>
+
+#define MAGIC "PULSELOG"
+
+// The records are accessed in place, hence they must not contain any padding
+Q_STATIC_ASSERT(sizeof(BinaryLogHeader) == 64);
+Q_STATIC_ASSERT(sizeof(BinaryLogRecord) == 48);
+
+
+/* ********************************************************************************************* *
+ * BinaryLogWriter
+ * ********************************************************************************************* */
+BinaryLogWriter::BinaryLogWriter()
+{
+  // pass...
+}
+
+bool
+BinaryLogWriter::open(const QString &filename, uint16_t period, int64_t startTime,
+                      const QString &serial)
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Binary logs are not supported on big-endian hosts.";
+  return false;
+#endif
+  if (! _file.open(filename))
+    return false;
+
+  BinaryLogHeader header;
+  memset(&header, 0, sizeof(BinaryLogHeader));
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version    = version;
+  header.headerSize = sizeof(BinaryLogHeader);
+  header.recordSize = sizeof(BinaryLogRecord);
+  header.period     = period;
+  header.startTime  = startTime;
+  QByteArray serialData = serial.toLatin1().left(sizeof(header.serial));
+  memcpy(header.serial, serialData.constData(), serialData.size());
+  return _file.write((const char *)&header, sizeof(BinaryLogHeader));
+}
+
+bool
+BinaryLogWriter::isOpen() const {
+  return _file.isOpen();
+}
+
+bool
+BinaryLogWriter::write(const BinaryLogRecord &record) {
+  return _file.write((const char *)&record, sizeof(BinaryLogRecord));
+}
+
+void
+BinaryLogWriter::close() {
+  _file.close();
+}
+
+AsyncWriter &
+BinaryLogWriter::writer() {
+  return _file;
+}
+
+const AsyncWriter &
+BinaryLogWriter::writer() const {
+  return _file;
+}
+
+
+/* ********************************************************************************************* *
+ * BinaryLogReader
+ * ********************************************************************************************* */
+BinaryLogReader::BinaryLogReader()
+  : _data(0), _records(0), _recordSize(0), _count(0)
+{
+  // pass...
+}
+
+BinaryLogReader::~BinaryLogReader() {
+  close();
+}
+
+bool
+BinaryLogReader::isBinaryLog(const QString &filename) {
+  QFile file(filename);
+  if (! file.open(QIODevice::ReadOnly))
+    return false;
+  return file.read(strlen(MAGIC)) == MAGIC;
+}
+
+bool
+BinaryLogReader::open(const QString &filename) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Binary logs are not supported on big-endian hosts.";
+  return false;
+#endif
+  close();
+  _file.setFileName(filename);
+  if (! _file.open(QIODevice::ReadOnly)) {
+    qDebug() << "Cannot open log" << filename << ":" << _file.errorString();
+    return false;
+  }
+  if (_file.size() < qint64(sizeof(BinaryLogHeader))) {
+    qDebug() << "Invalid log" << filename << ": Truncated header.";
+    _file.close();
+    return false;
+  }
+  if (0 == (_data = _file.map(0, _file.size()))) {
+    qDebug() << "Cannot map log" << filename << ":" << _file.errorString();
+    _file.close();
+    return false;
+  }
+
+  const BinaryLogHeader &hdr = header();
+  // Later versions only append fields, hence they can be read as well
+  if ((0 != memcmp(hdr.magic, MAGIC, sizeof(hdr.magic))) || (0 == hdr.version) ||
+      (0 == hdr.period) || (hdr.headerSize < sizeof(BinaryLogHeader)) ||
+      (hdr.recordSize < sizeof(BinaryLogRecord)) || (hdr.headerSize > _file.size())) {
+    qDebug() << "Invalid log" << filename << ": Unknown format.";
+    close();
+    return false;
+  }
+  _records    = _data + hdr.headerSize;
+  _recordSize = hdr.recordSize;
+  _count      = (_file.size() - hdr.headerSize)/_recordSize;
+  return true;
+}
+
+void
+BinaryLogReader::close() {
+  if (_data)
+    _file.unmap(_data);
+  _file.close();
+  _data = 0; _records = 0;
+  _recordSize = _count = 0;
+}
+
+bool
+BinaryLogReader::isOpen() const {
+  return 0 != _data;
+}
+
+const BinaryLogHeader &
+BinaryLogReader::header() const {
+  return *reinterpret_cast<const BinaryLogHeader *>(_data);
+}
+
+size_t
+BinaryLogReader::size() const {
+  return _count;
+}
+
+size_t
+BinaryLogReader::find(uint32_t t) const {
+  size_t lo = 0, hi = _count;
+  while (lo < hi) {
+    size_t mid = (lo+hi)/2;
+    if (record(mid).t < t)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
@@ -0,0 +1,133 @@
+#ifndef BINARYLOG_HH
+#define BINARYLOG_HH
+
+#include <QString>
+#include <QFile>
+#include "asyncwriter.hh"
+#include <cinttypes>
+
+
+/** Header of a binary log file.
+ *
+ * A binary log consists of this header followed by fixed-size records. All values are stored in
+ * little-endian byte order. Later versions may only append fields to the header and the records,
+ * hence readers must use @c headerSize and @c recordSize to locate the records. */
+struct BinaryLogHeader
+{
+  /** Magic bytes "PULSELOG". */
+  char     magic[8];
+  /** Format version. */
+  uint16_t version;
+  /** Size of the header in bytes. */
+  uint16_t headerSize;
+  /** Size of each record in bytes. */
+  uint16_t recordSize;
+  /** Sample period in ms. */
+  uint16_t period;
+  /** Start of the recording in ms since epoch (UTC). */
+  int64_t  startTime;
+  /** Serial number of the device (0-terminated, if shorter). */
+  char     serial[32];
+  uint8_t  reserved[8];
+};
+
+
+/** A single record of a binary log. */
+struct BinaryLogRecord
+{
+  /** Record flags. */
+  typedef enum {
+    VALID = 1,  ///< Signal quality was sufficient.
+    BEAT  = 2   ///< A heartbeat was detected.
+  } Flags;
+
+  /** Time in ms since the start of the recording. */
+  uint32_t t;
+  /** Raw ADC sums of the base, IR and RED intensities as received from the device. */
+  uint16_t base, ir, red;
+  /** Combination of @c Flags. */
+  uint8_t  flags;
+  /** Signal quality index scaled to [0,255]. */
+  uint8_t  quality;
+  /** Derived values. */
+  float    spo2, pulse;
+  float    irMean, irPulse, irStd;
+  float    redMean, redPulse, redStd;
+  float    ratio;
+};
+
+
+/** Writes a binary log. The records get written asynchronously (see @c AsyncWriter). */
+class BinaryLogWriter
+{
+public:
+  /** Current format version. */
+  const static uint16_t version = 1;
+
+public:
+  BinaryLogWriter();
+
+  /** Creates the log file and writes the header. Returns @c false on error. */
+  bool open(const QString &filename, uint16_t period, int64_t startTime, const QString &serial);
+  /** Returns @c true if a log file is open. */
+  bool isOpen() const;
+  /** Appends a record. Returns @c false if the record got dropped. */
+  bool write(const BinaryLogRecord &record);
+  /** Closes the log file. */
+  void close();
+
+  /** Returns the writer (e.g., to set the sync policy or to obtain the drop counts). */
+  AsyncWriter &writer();
+  /** Returns the writer. */
+  const AsyncWriter &writer() const;
+
+protected:
+  AsyncWriter _file;
+};
+
+
+/** Zero-copy reader of binary logs.
+ *
+ * The file gets mapped into memory, records are accessed in place. Hence opening a file costs
+ * constant time independent of its length. As the records have a fixed size and are sorted by
+ * time, seeking is a binary search over the records and needs no separate time index. An
+ * incomplete last record (e.g., after a crash) gets ignored. */
+class BinaryLogReader
+{
+public:
+  BinaryLogReader();
+  ~BinaryLogReader();
+
+  /** Returns @c true if the given file starts with the binary log magic. */
+  static bool isBinaryLog(const QString &filename);
+
+  /** Maps the given log file. Returns @c false on error. */
+  bool open(const QString &filename);
+  /** Unmaps the file. */
+  void close();
+  /** Returns @c true if a log file is mapped. */
+  bool isOpen() const;
+
+  /** Returns the header of the log. */
+  const BinaryLogHeader &header() const;
+  /** Returns the number of records. */
+  size_t size() const;
+  /** Returns the i-th record. */
+  inline const BinaryLogRecord &record(size_t i) const {
+    return *reinterpret_cast<const BinaryLogRecord *>(_records + i*_recordSize);
+  }
+  /** Returns the index of the first record at or after @c t ms. Returns the number of records if
+   * there is none. */
+  size_t find(uint32_t t) const;
+
+protected:
+  QFile _file;
+  /** The mapped file. */
+  uchar *_data;
+  /** Start of the records. */
+  const uchar *_records;
+  size_t _recordSize;
+  size_t _count;
+};
+
+#endif // BINARYLOG_HH
@@ -0,0 +1,169 @@
+#include "calibration.hh"
+#include <QSettings>
+#include <QFileInfo>
+#include <QStringList>
+#include <QDebug>
+
+
+/* ********************************************************************************************* *
+ * CalibrationCurve
+ * ********************************************************************************************* */
+CalibrationCurve::CalibrationCurve(double rMin, double rMax)
+  : _rMin(rMin), _scale((rMin < rMax) ? size/(rMax-rMin) : 0)
+{
+  for (uint16_t i=0; i<=size; i++)
+    _table[i] = 0;
+}
+
+CalibrationCurve::CalibrationCurve()
+  : _rMin(0), _scale(0)
+{
+  // Taken from NXP AN4327
+  QVector< QPair<double,double> > points;
+  points.append(qMakePair(0., 110.));
+  points.append(qMakePair(1., 85.));
+  points.append(qMakePair(3.4, 0.));
+  *this = fromTable(points);
+}
+
+CalibrationCurve
+CalibrationCurve::fromPolynomial(const QVector<double> &coef, double rMin, double rMax) {
+  CalibrationCurve curve(rMin, rMax);
+  if ((0 == coef.size()) || (! curve.isValid()))
+    return CalibrationCurve(0, 0);
+  for (uint16_t i=0; i<=size; i++) {
+    double r = rMin + i/curve._scale, y = 0;
+    for (int j=coef.size()-1; j>=0; j--)
+      y = y*r + coef[j];
+    curve._table[i] = y;
+  }
+  return curve;
+}
+
+CalibrationCurve
+CalibrationCurve::fromTable(const QVector< QPair<double, double> > &points) {
+  if (2 > points.size())
+    return CalibrationCurve(0, 0);
+  // The segment search below relies on sorted ratios
+  for (int i=1; i<points.size(); i++) {
+    if (! (points[i-1].first < points[i].first))
+      return CalibrationCurve(0, 0);
+  }
+  double rMin = points.first().first, rMax = points.last().first;
+  CalibrationCurve curve(rMin, rMax);
+  if (! curve.isValid())
+    return curve;
+
+  int j = 0;
+  for (uint16_t i=0; i<=size; i++) {
+    double r = rMin + i/curve._scale;
+    // find segment [j, j+1] containing r
+    while ((j < (points.size()-2)) && (r > points[j+1].first))
+      j++;
+    double dr = points[j+1].first - points[j].first;
+    double a  = (dr > 0) ? (r-points[j].first)/dr : 0;
+    curve._table[i] = (1-a)*points[j].second + a*points[j+1].second;
+  }
+  return curve;
+}
+
+bool
+CalibrationCurve::isValid() const {
+  return 0 < _scale;
+}
+
+
+/* ********************************************************************************************* *
+ * Calibration
+ * ********************************************************************************************* */
+Calibration::Calibration()
+  : _default(), _curves()
+{
+  // pass...
+}
+
+bool
+Calibration::load(const QString &filename) {
+  if (! QFileInfo(filename).isReadable()) {
+    qDebug() << "Cannot read calibration file" << filename;
+    return false;
+  }
+
+  QSettings file(filename, QSettings::IniFormat);
+  CalibrationCurve defaultCurve;
+  QHash<QString, CalibrationCurve> curves;
+  foreach (QString group, file.childGroups()) {
+    file.beginGroup(group);
+    CalibrationCurve curve;
+    if (file.contains("points")) {
+      QVector< QPair<double,double> > points;
+      foreach (QString point, file.value("points").toStringList()) {
+        QStringList pair = point.split(":");
+        bool okRatio = false, okSpO2 = false;
+        double ratio = 0, spo2 = 0;
+        if (2 == pair.size()) {
+          ratio = pair[0].trimmed().toDouble(&okRatio);
+          spo2  = pair[1].trimmed().toDouble(&okSpO2);
+        }
+        if ((! okRatio) || (! okSpO2)) {
+          qDebug() << "Malformed calibration point" << point << "for" << group << "in" << filename;
+          return false;
+        }
+        if (points.size() && (ratio <= points.last().first)) {
+          qDebug() << "Calibration point" << point << "for" << group << "in" << filename
+                   << "does not follow the previous ratio.";
+          return false;
+        }
+        points.append(qMakePair(ratio, spo2));
+      }
+      curve = CalibrationCurve::fromTable(points);
+    } else if (file.contains("coefficients")) {
+      QVector<double> coef;
+      foreach (QString c, file.value("coefficients").toStringList()) {
+        bool ok = false;
+        coef.append(c.trimmed().toDouble(&ok));
+        if (! ok) {
+          qDebug() << "Malformed calibration coefficient" << c << "for" << group
+                   << "in" << filename;
+          return false;
+        }
+      }
+      QStringList range = file.value("range", QStringList() << "0" << "4").toStringList();
+      if (2 == range.size())
+        curve = CalibrationCurve::fromPolynomial(
+              coef, range[0].trimmed().toDouble(), range[1].trimmed().toDouble());
+      else
+        curve = CalibrationCurve(0, 0);
+    } else {
+      curve = CalibrationCurve(0, 0);
+    }
+    file.endGroup();
+
+    if (! curve.isValid()) {
+      qDebug() << "Invalid calibration curve for" << group << "in" << filename;
+      return false;
+    }
+    if ("default" == group)
+      defaultCurve = curve;
+    else
+      curves.insert(group, curve);
+  }
+
+  _default = defaultCurve;
+  _curves  = curves;
+  return true;
+}
+
+void
+Calibration::reset() {
+  _default = CalibrationCurve();
+  _curves.clear();
+}
+
+const CalibrationCurve &
+Calibration::curve(const QString &serial) const {
+  QHash<QString, CalibrationCurve>::const_iterator item = _curves.find(serial);
+  if (_curves.constEnd() == item)
+    return _default;
+  return *item;
+}
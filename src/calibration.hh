@@ -0,0 +1,97 @@
+#ifndef CALIBRATION_HH
+#define CALIBRATION_HH
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <cinttypes>
+#include <algorithm>
+
+
+/** A calibration curve mapping the ratio of ratios to a SpO2 value in percent.
+ *
+ * Irrespective of its definition (polynomial or piecewise-linear table), the curve is sampled into
+ * a uniform lookup table over the ratio range and evaluated by a branch-free linear interpolation.
+ * Ratios outside of the range are clamped to the range. */
+class CalibrationCurve
+{
+public:
+  /// Number of intervals of the lookup table.
+  const static uint16_t size = 256;
+
+public:
+  /** Constructs the default curve taken from NXP AN4327. */
+  CalibrationCurve();
+  /** Constructs an empty curve over the ratio range [rMin, rMax], the curve is invalid if
+   * rMin >= rMax. */
+  CalibrationCurve(double rMin, double rMax);
+
+  /** Constructs a curve from the polynomial coefficients @c coef (in ascending order)
+   * over the ratio range [rMin, rMax]. */
+  static CalibrationCurve fromPolynomial(const QVector<double> &coef, double rMin, double rMax);
+  /** Constructs a piecewise-linear curve from the given (ratio, SpO2) points. The ratio range is
+   * given by the first and last point. Returns an invalid curve if less than two points are
+   * given or the ratios are not strictly increasing. */
+  static CalibrationCurve fromTable(const QVector< QPair<double,double> > &points);
+
+  /** Returns @c true if the curve is valid. */
+  bool isValid() const;
+
+  /** Maps the given ratio to the SpO2 value. */
+  inline double eval(double r) const {
+    double x = std::min(double(size), std::max(0., (r-_rMin)*_scale));
+    uint16_t i = std::min(uint16_t(x), uint16_t(size-1));
+    double a = x-i;
+    return (1-a)*_table[i] + a*_table[i+1];
+  }
+
+protected:
+  /** Lower bound of the ratio range. */
+  double _rMin;
+  /** Number of table intervals per ratio unit. */
+  double _scale;
+  /** The lookup table. */
+  double _table[size+1];
+};
+
+
+/** Holds the calibration curves of several sensors, identified by the device serial number.
+ *
+ * The curves are read from an INI file with one group per serial number. The group @c default
+ * defines the curve for all devices not listed explicitly. Each group specifies the curve
+ * by either
+ * @code
+ * [SERIAL]
+ * points=0:110, 1:85, 3.4:0
+ * @endcode
+ * as a piecewise-linear table of ratio:SpO2 pairs (in strictly increasing order of the ratio) or
+ * @code
+ * [SERIAL]
+ * coefficients=110, -25
+ * range=0, 4.4
+ * @endcode
+ * as a polynomial in the ratio (coefficients in ascending order) over the given ratio range. */
+class Calibration
+{
+public:
+  /** Constructs a calibration using the default curve for all devices. */
+  Calibration();
+
+  /** Loads the curves from the given file. Returns @c false on error (e.g., a malformed curve),
+   * the calibration is unchanged in this case. */
+  bool load(const QString &filename);
+  /** Resets the calibration to the default curve for all devices. */
+  void reset();
+
+  /** Returns the curve for the device with the given serial number. */
+  const CalibrationCurve &curve(const QString &serial) const;
+
+protected:
+  /** The default curve. */
+  CalibrationCurve _default;
+  /** Curves by serial number. */
+  QHash<QString, CalibrationCurve> _curves;
+};
+
+#endif // CALIBRATION_HH
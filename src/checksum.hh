@@ -0,0 +1,39 @@
+#ifndef CHECKSUM_HH
+#define CHECKSUM_HH
+
+#include <cinttypes>
+#include <cstddef>
+
+
+/* CRC-32 (IEEE 802.3, as used by zlib and PNG) of the blocks of the recording formats. It
+ * detects torn or garbage blocks left by a crash, hence readers and the recovery can find the
+ * last valid block. */
+
+
+/** Lookup table of the CRC-32, one entry per byte value. */
+struct CRC32Table
+{
+  uint32_t entries[256];
+
+  CRC32Table() {
+    for (uint32_t i=0; i<256; i++) {
+      uint32_t c = i;
+      for (int k=0; k<8; k++)
+        c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+      entries[i] = c;
+    }
+  }
+};
+
+/** Returns the CRC-32 of @c len bytes at @c data. Pass the CRC of the preceding data as @c crc to
+ * continue the checksum over several ranges. */
+static inline uint32_t crc32(const void *data, size_t len, uint32_t crc=0) {
+  static const CRC32Table table;
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  crc = ~crc;
+  for (size_t i=0; i<len; i++)
+    crc = table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+#endif // CHECKSUM_HH
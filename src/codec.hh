@@ -0,0 +1,227 @@
+#ifndef CODEC_HH
+#define CODEC_HH
+
+#include <vector>
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+
+/* Column codecs of the columnar recording format. Integer columns get stored as the zigzag
+ * encoded deltas between successive values as varints, hence slowly changing values take a
+ * single byte. Float columns get stored as the XOR of successive values (Gorilla encoding), only
+ * the meaningful bits of the XOR are stored. Encoders append to a byte vector, decoders read
+ * from a plain memory range (e.g., a memory-mapped file). */
+
+
+/** Maps signed integers to unsigned ones, such that small magnitudes yield small values. */
+static inline uint64_t zigzag(int64_t v) {
+  return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+/** Inverse of @c zigzag. */
+static inline int64_t unzigzag(uint64_t v) {
+  return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+
+/** Delta + zigzag + varint encoder of integer columns. */
+class IntEncoder
+{
+public:
+  IntEncoder()
+    : _last(0)
+  {
+    // pass...
+  }
+
+  /** Clears the encoded data. */
+  void reset() {
+    _data.clear();
+    _last = 0;
+  }
+
+  inline void append(int64_t value) {
+    uint64_t v = zigzag(value-_last);
+    _last = value;
+    while (v >= 0x80) {
+      _data.push_back(uint8_t(v) | 0x80);
+      v >>= 7;
+    }
+    _data.push_back(uint8_t(v));
+  }
+
+  /** Returns the encoded data. */
+  const std::vector<uint8_t> &data() const {
+    return _data;
+  }
+
+protected:
+  std::vector<uint8_t> _data;
+  int64_t _last;
+};
+
+
+/** Decoder of integer columns encoded by @c IntEncoder. */
+class IntDecoder
+{
+public:
+  IntDecoder(const uint8_t *data, size_t size)
+    : _ptr(data), _end(data+size), _last(0)
+  {
+    // pass...
+  }
+
+  /** Decodes the next value. Returns @c false if the data is exhausted or corrupted. */
+  inline bool next(int64_t &value) {
+    uint64_t v = 0;
+    for (int shift=0; (_ptr < _end) && (shift < 64); shift += 7) {
+      uint8_t byte = *_ptr++;
+      v |= uint64_t(byte & 0x7f) << shift;
+      if (0 == (byte & 0x80)) {
+        value = _last = _last + unzigzag(v);
+        return true;
+      }
+    }
+    return false;
+  }
+
+protected:
+  const uint8_t *_ptr;
+  const uint8_t *_end;
+  int64_t _last;
+};
+
+
+/** XOR (Gorilla) encoder of float columns.
+ *
+ * Each value gets XORed with its predecessor. A zero XOR is stored as a single 0 bit. Otherwise,
+ * if the meaningful bits fit into the window of the previous value, "10" followed by the bits in
+ * that window is stored. Else "11", the number of leading zeros (5 bits), the number of
+ * meaningful bits minus one (5 bits) and the meaningful bits are stored. */
+class FloatEncoder
+{
+public:
+  FloatEncoder()
+  {
+    reset();
+  }
+
+  /** Clears the encoded data. */
+  void reset() {
+    _data.clear();
+    _bits = 0;
+    _last = 0;
+    _leading = 32; _trailing = 0;
+  }
+
+  inline void append(float value) {
+    uint32_t v; memcpy(&v, &value, sizeof(float));
+    uint32_t x = v ^ _last;
+    _last = v;
+    if (0 == x) {
+      _put(0, 1);
+      return;
+    }
+    int leading = __builtin_clz(x), trailing = __builtin_ctz(x);
+    if ((leading >= _leading) && (trailing >= _trailing)) {
+      _put(2, 2);
+      _put(x >> _trailing, 32-_leading-_trailing);
+      return;
+    }
+    _leading = std::min(leading, 31); _trailing = trailing;
+    int length = 32-_leading-_trailing;
+    _put(3, 2);
+    _put(_leading, 5);
+    _put(length-1, 5);
+    _put(x >> _trailing, length);
+  }
+
+  /** Returns the encoded data. */
+  const std::vector<uint8_t> &data() const {
+    return _data;
+  }
+
+protected:
+  /** Appends the lowest @c n bits of @c bits (MSB first). */
+  inline void _put(uint32_t bits, int n) {
+    while (n > 0) {
+      if (0 == (_bits & 7))
+        _data.push_back(0);
+      int free = 8 - (_bits & 7);
+      int k = std::min(free, n);
+      uint8_t chunk = uint8_t((bits >> (n-k)) & ((1u << k)-1));
+      _data.back() |= chunk << (free-k);
+      _bits += k; n -= k;
+    }
+  }
+
+protected:
+  std::vector<uint8_t> _data;
+  size_t _bits;
+  uint32_t _last;
+  int _leading, _trailing;
+};
+
+
+/** Decoder of float columns encoded by @c FloatEncoder. */
+class FloatDecoder
+{
+public:
+  FloatDecoder(const uint8_t *data, size_t size)
+    : _data(data), _size(8*size), _bit(0), _last(0), _leading(32), _trailing(0)
+  {
+    // pass...
+  }
+
+  /** Decodes the next value. Returns @c false if the data is exhausted. */
+  inline bool next(float &value) {
+    uint32_t ctrl;
+    if (! _get(ctrl, 1))
+      return false;
+    if (ctrl) {
+      if (! _get(ctrl, 1))
+        return false;
+      if (ctrl) {
+        uint32_t leading, length;
+        if ((! _get(leading, 5)) || (! _get(length, 5)))
+          return false;
+        _leading = leading; _trailing = 32-leading-(length+1);
+        if (_trailing < 0)
+          return false;
+      }
+      uint32_t x;
+      if (! _get(x, 32-_leading-_trailing))
+        return false;
+      _last ^= x << _trailing;
+    }
+    memcpy(&value, &_last, sizeof(float));
+    return true;
+  }
+
+protected:
+  /** Reads the next @c n bits (MSB first). */
+  inline bool _get(uint32_t &bits, int n) {
+    if ((_bit + n) > _size)
+      return false;
+    bits = 0;
+    while (n > 0) {
+      int offset = _bit & 7;
+      int k = std::min(8-offset, n);
+      uint8_t byte = _data[_bit >> 3];
+      bits = (bits << k) | ((byte >> (8-offset-k)) & ((1u << k)-1));
+      _bit += k; n -= k;
+    }
+    return true;
+  }
+
+protected:
+  const uint8_t *_data;
+  size_t _size;
+  size_t _bit;
+  uint32_t _last;
+  int _leading, _trailing;
+};
+
+#endif // CODEC_HH
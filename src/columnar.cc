@@ -0,0 +1,445 @@
+#include "columnar.hh"
+#include <QtGlobal>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#define MAGIC "PULSECOL"
+
+Q_STATIC_ASSERT(sizeof(ColumnarHeader) == 64);
+Q_STATIC_ASSERT(sizeof(ColumnarBlockHeader) == 16);
+
+// Size of the block headers of version 1 (without checksum)
+#define BLOCK_HEADER_SIZE_V1 8
+Q_STATIC_ASSERT(sizeof(ColumnarColumn) == 24);
+
+// Column data gets padded to multiples of 8 bytes, to keep the column headers aligned
+#define PADDED(size) (((size)+7) & ~size_t(7))
+
+
+/** Returns the value of the given column of a record. */
+static inline double
+columnValue(const BinaryLogRecord &record, int column) {
+  switch (column) {
+  case COL_T: return record.t;
+  case COL_BASE: return record.base;
+  case COL_IR: return record.ir;
+  case COL_RED: return record.red;
+  case COL_FLAGS: return record.flags;
+  case COL_QUALITY: return record.quality;
+  case COL_SPO2: return record.spo2;
+  case COL_PULSE: return record.pulse;
+  case COL_IR_MEAN: return record.irMean;
+  case COL_IR_PULSE: return record.irPulse;
+  case COL_IR_STD: return record.irStd;
+  case COL_RED_MEAN: return record.redMean;
+  case COL_RED_PULSE: return record.redPulse;
+  case COL_RED_STD: return record.redStd;
+  case COL_RATIO: return record.ratio;
+  default: break;
+  }
+  return 0;
+}
+
+/** Sets the value of the given column of a record. */
+static inline void
+setColumnValue(BinaryLogRecord &record, int column, double value) {
+  switch (column) {
+  case COL_T: record.t = value; break;
+  case COL_BASE: record.base = value; break;
+  case COL_IR: record.ir = value; break;
+  case COL_RED: record.red = value; break;
+  case COL_FLAGS: record.flags = value; break;
+  case COL_QUALITY: record.quality = value; break;
+  case COL_SPO2: record.spo2 = value; break;
+  case COL_PULSE: record.pulse = value; break;
+  case COL_IR_MEAN: record.irMean = value; break;
+  case COL_IR_PULSE: record.irPulse = value; break;
+  case COL_IR_STD: record.irStd = value; break;
+  case COL_RED_MEAN: record.redMean = value; break;
+  case COL_RED_PULSE: record.redPulse = value; break;
+  case COL_RED_STD: record.redStd = value; break;
+  case COL_RATIO: record.ratio = value; break;
+  default: break;
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * ColumnarWriter
+ * ********************************************************************************************* */
+ColumnarWriter::ColumnarWriter(uint32_t rowsPerBlock)
+  : _file(int(2*maxBlockSize(std::max(uint32_t(1), rowsPerBlock)))), _index(), _offset(0),
+    _written(0), _rowsPerBlock(std::max(uint32_t(1), rowsPerBlock)), _rows(0)
+{
+  // pass...
+}
+
+size_t
+ColumnarWriter::maxBlockSize(uint32_t rows) {
+  // A varint of a 64bit delta takes up to 10 bytes, a float up to 2+5+5+32 bits
+  size_t size = sizeof(ColumnarBlockHeader) + COL_COUNT*(sizeof(ColumnarColumn)+7);
+  size += COL_FIRST_FLOAT*10*size_t(rows);
+  size += (COL_COUNT-COL_FIRST_FLOAT)*((44*size_t(rows)+7)/8);
+  return size;
+}
+
+bool
+ColumnarWriter::open(const QString &filename, uint16_t period, int64_t startTime,
+                     const QString &serial)
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Columnar recordings are not supported on big-endian hosts.";
+  return false;
+#endif
+  if (! _file.open(filename))
+    return false;
+
+  ColumnarHeader header;
+  memset(&header, 0, sizeof(ColumnarHeader));
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version      = version;
+  header.headerSize   = sizeof(ColumnarHeader);
+  header.columns      = COL_COUNT;
+  header.period       = period;
+  header.startTime    = startTime;
+  header.rowsPerBlock = _rowsPerBlock;
+  QByteArray serialData = serial.toLatin1().left(sizeof(header.serial));
+  memcpy(header.serial, serialData.constData(), serialData.size());
+
+  _rows = 0; _offset = sizeof(ColumnarHeader); _written = 0;
+  // The index is optional, readers rebuild it if missing or incomplete
+  _index.open(filename, startTime);
+  return _file.write((const char *)&header, sizeof(ColumnarHeader));
+}
+
+bool
+ColumnarWriter::isOpen() const {
+  return _file.isOpen();
+}
+
+bool
+ColumnarWriter::write(const BinaryLogRecord &record) {
+  if (0 == _rows) {
+    for (int c=0; c<COL_FIRST_FLOAT; c++)
+      _ints[c].reset();
+    for (int c=COL_FIRST_FLOAT; c<COL_COUNT; c++)
+      _floats[c-COL_FIRST_FLOAT].reset();
+    for (int c=0; c<COL_COUNT; c++) {
+      _min[c] = std::numeric_limits<double>::infinity();
+      _max[c] = -std::numeric_limits<double>::infinity();
+    }
+  }
+
+  for (int c=0; c<COL_COUNT; c++) {
+    double value = columnValue(record, c);
+    if (c < COL_FIRST_FLOAT)
+      _ints[c].append(int64_t(value));
+    else
+      _floats[c-COL_FIRST_FLOAT].append(float(value));
+    // NaN fails both comparisons
+    if (value < _min[c]) _min[c] = value;
+    if (value > _max[c]) _max[c] = value;
+  }
+
+  if (++_rows < _rowsPerBlock)
+    return true;
+  return _flush();
+}
+
+void
+ColumnarWriter::close() {
+  if (! _file.isOpen())
+    return;
+  if (_rows)
+    _flush();
+  _index.close();
+  _file.close();
+}
+
+AsyncWriter &
+ColumnarWriter::writer() {
+  return _file;
+}
+
+const AsyncWriter &
+ColumnarWriter::writer() const {
+  return _file;
+}
+
+bool
+ColumnarWriter::_flush() {
+  _block.resize(sizeof(ColumnarBlockHeader));
+  for (int c=0; c<COL_COUNT; c++) {
+    const std::vector<uint8_t> &data = (c < COL_FIRST_FLOAT) ?
+          _ints[c].data() : _floats[c-COL_FIRST_FLOAT].data();
+    ColumnarColumn column;
+    column.min = _min[c]; column.max = _max[c];
+    column.size = data.size();
+    column.reserved = 0;
+    _block.append((const char *)&column, sizeof(ColumnarColumn));
+    _block.append((const char *)data.data(), data.size());
+    _block.append(QByteArray(int(PADDED(data.size())-data.size()), '\0'));
+  }
+  ColumnarBlockHeader *header = reinterpret_cast<ColumnarBlockHeader *>(_block.data());
+  header->rows = _rows;
+  header->size = _block.size()-sizeof(ColumnarBlockHeader);
+  header->crc  = crc32(_block.constData()+sizeof(ColumnarBlockHeader), header->size,
+                       crc32(header, BLOCK_HEADER_SIZE_V1));
+  header->reserved = 0;
+  TimeIndexEntry entry;
+  entry.offset = _offset;
+  entry.row    = _written;
+  entry.tFirst = _min[COL_T];
+  entry.tLast  = _max[COL_T];
+  uint32_t rows = _rows;
+  _rows = 0;
+  if (! _file.write(_block))
+    return false;
+  _offset += _block.size(); _written += rows;
+  if (_index.isOpen())
+    _index.add(entry);
+  return true;
+}
+
+
+/* ********************************************************************************************* *
+ * ColumnarReader
+ * ********************************************************************************************* */
+ColumnarReader::ColumnarReader()
+  : _data(0), _rows(0), _blockHeaderSize(sizeof(ColumnarBlockHeader)), _end(0)
+{
+  // pass...
+}
+
+ColumnarReader::~ColumnarReader() {
+  close();
+}
+
+bool
+ColumnarReader::isColumnar(const QString &filename) {
+  QFile file(filename);
+  if (! file.open(QIODevice::ReadOnly))
+    return false;
+  return file.read(strlen(MAGIC)) == MAGIC;
+}
+
+bool
+ColumnarReader::open(const QString &filename) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Columnar recordings are not supported on big-endian hosts.";
+  return false;
+#endif
+  close();
+  _file.setFileName(filename);
+  if (! _file.open(QIODevice::ReadOnly)) {
+    qDebug() << "Cannot open recording" << filename << ":" << _file.errorString();
+    return false;
+  }
+  size_t fileSize = _file.size();
+  if (fileSize < sizeof(ColumnarHeader)) {
+    qDebug() << "Invalid recording" << filename << ": Truncated header.";
+    _file.close();
+    return false;
+  }
+  if (0 == (_data = _file.map(0, fileSize))) {
+    qDebug() << "Cannot map recording" << filename << ":" << _file.errorString();
+    _file.close();
+    return false;
+  }
+
+  const ColumnarHeader &hdr = header();
+  if ((0 != memcmp(hdr.magic, MAGIC, sizeof(hdr.magic))) || (0 == hdr.version) ||
+      (0 == hdr.period) || (hdr.headerSize < sizeof(ColumnarHeader)) ||
+      (hdr.headerSize > fileSize) || (hdr.columns < COL_COUNT)) {
+    qDebug() << "Invalid recording" << filename << ": Unknown format.";
+    close();
+    return false;
+  }
+  _blockHeaderSize = (hdr.version < 2) ? BLOCK_HEADER_SIZE_V1 : sizeof(ColumnarBlockHeader);
+
+  // Re-check the last indexed block (it may be incomplete) and index all blocks following it
+  size_t offset = hdr.headerSize;
+  if (_index.open(filename, hdr.startTime, fileSize) && _index.size() &&
+      (_index.last().offset >= hdr.headerSize)) {
+    const TimeIndexEntry &last = _index.last();
+    offset = last.offset; _rows = last.row;
+    _index.resize(_index.size()-1);
+  } else {
+    _index.close();
+  }
+  Block block; size_t end;
+  while (_parseBlock(offset, _rows, block, end, true)) {
+    TimeIndexEntry entry;
+    entry.offset = offset;
+    entry.row    = _rows;
+    entry.tFirst = block.columns[COL_T]->min;
+    entry.tLast  = block.columns[COL_T]->max;
+    _index.append(entry);
+    _rows += block.rows;
+    offset = end;
+  }
+  _end = offset;
+  return true;
+}
+
+void
+ColumnarReader::close() {
+  if (_data)
+    _file.unmap(_data);
+  _file.close();
+  _data = 0;
+  _index.close();
+  _rows = 0; _end = 0;
+}
+
+bool
+ColumnarReader::isOpen() const {
+  return 0 != _data;
+}
+
+const ColumnarHeader &
+ColumnarReader::header() const {
+  return *reinterpret_cast<const ColumnarHeader *>(_data);
+}
+
+size_t
+ColumnarReader::size() const {
+  return _rows;
+}
+
+size_t
+ColumnarReader::validSize() const {
+  return _end;
+}
+
+size_t
+ColumnarReader::verify() const {
+  size_t offset = header().headerSize, rows = 0, end;
+  Block block;
+  while (_parseBlock(offset, rows, block, end, true)) {
+    rows += block.rows;
+    offset = end;
+  }
+  return offset;
+}
+
+size_t
+ColumnarReader::blockCount() const {
+  return _index.size();
+}
+
+bool
+ColumnarReader::block(size_t i, Block &block) const {
+  const TimeIndexEntry &entry = _index.entry(i);
+  size_t end;
+  return _parseBlock(entry.offset, entry.row, block, end, false);
+}
+
+size_t
+ColumnarReader::find(uint32_t t) const {
+  size_t i = _index.findTime(t);
+  if (i >= _index.size())
+    return _rows;
+  Block blk;
+  if (! block(i, blk))
+    return _rows;
+  QVector<double> times(blk.rows);
+  if (! _decodeColumn(blk, COL_T, times.data()))
+    return _rows;
+  return blk.firstRow + (std::lower_bound(times.begin(), times.end(), double(t)) - times.begin());
+}
+
+size_t
+ColumnarReader::findBlock(size_t row) const {
+  return _index.findRow(row);
+}
+
+bool
+ColumnarReader::decodeColumn(size_t i, ColumnarColumnId column, double *out) const {
+  Block blk;
+  return block(i, blk) && _decodeColumn(blk, column, out);
+}
+
+bool
+ColumnarReader::decodeBlock(size_t i, BinaryLogRecord *out) const {
+  Block blk;
+  if (! block(i, blk))
+    return false;
+  QVector<double> values(blk.rows);
+  for (int c=0; c<COL_COUNT; c++) {
+    if (! _decodeColumn(blk, ColumnarColumnId(c), values.data()))
+      return false;
+    for (size_t j=0; j<blk.rows; j++)
+      setColumnValue(out[j], c, values[j]);
+  }
+  return true;
+}
+
+QVector<size_t>
+ColumnarReader::findBlocks(ColumnarColumnId column, double lower, double upper) const {
+  QVector<size_t> blocks;
+  Block blk;
+  for (size_t i=0; i<_index.size(); i++) {
+    if (! block(i, blk))
+      continue;
+    const ColumnarColumn *stats = blk.columns[column];
+    if ((stats->max >= lower) && (stats->min <= upper))
+      blocks.append(i);
+  }
+  return blocks;
+}
+
+bool
+ColumnarReader::_parseBlock(size_t offset, size_t firstRow, Block &block, size_t &end,
+                            bool checkCrc) const {
+  size_t fileSize = _file.size();
+  block.firstRow = firstRow;
+  if ((offset + _blockHeaderSize) > fileSize)
+    return false;
+  const ColumnarBlockHeader *bhdr = reinterpret_cast<const ColumnarBlockHeader *>(_data+offset);
+  size_t col = offset + _blockHeaderSize;
+  end = col + bhdr->size;
+  if (end > fileSize)
+    return false;
+  if (checkCrc && (_blockHeaderSize > BLOCK_HEADER_SIZE_V1) &&
+      (bhdr->crc != crc32(_data+col, bhdr->size, crc32(bhdr, BLOCK_HEADER_SIZE_V1))))
+    return false;
+  block.rows = bhdr->rows;
+  for (int c=0; c<header().columns; c++) {
+    const ColumnarColumn *column = reinterpret_cast<const ColumnarColumn *>(_data+col);
+    if (((col + sizeof(ColumnarColumn)) > end) ||
+        ((col + sizeof(ColumnarColumn) + PADDED(column->size)) > end))
+      return false;
+    if (c < COL_COUNT) {
+      block.columns[c] = column;
+      block.data[c] = _data + col + sizeof(ColumnarColumn);
+    }
+    col += sizeof(ColumnarColumn) + PADDED(column->size);
+  }
+  return true;
+}
+
+bool
+ColumnarReader::_decodeColumn(const Block &block, ColumnarColumnId column, double *out) {
+  if (column < COL_FIRST_FLOAT) {
+    IntDecoder decoder(block.data[column], block.columns[column]->size);
+    int64_t value;
+    for (size_t j=0; j<block.rows; j++) {
+      if (! decoder.next(value))
+        return false;
+      out[j] = value;
+    }
+  } else {
+    FloatDecoder decoder(block.data[column], block.columns[column]->size);
+    float value;
+    for (size_t j=0; j<block.rows; j++) {
+      if (! decoder.next(value))
+        return false;
+      out[j] = value;
+    }
+  }
+  return true;
+}
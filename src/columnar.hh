@@ -0,0 +1,220 @@
+#ifndef COLUMNAR_HH
+#define COLUMNAR_HH
+
+#include <QString>
+#include <QFile>
+#include <QVector>
+#include "binarylog.hh"
+#include "codec.hh"
+#include "checksum.hh"
+#include "timeindex.hh"
+
+
+/** Header of a columnar recording.
+ *
+ * A columnar recording stores the same values as a binary log (see @c BinaryLogRecord), but
+ * compressed column by column in blocks of up to @c rowsPerBlock rows. The header is followed by
+ * the blocks, each block consists of a @c ColumnarBlockHeader followed by a @c ColumnarColumn
+ * header and the encoded data for each column. All values are stored in little-endian byte
+ * order. Each block carries a checksum, hence a block torn or garbled by a crash gets detected
+ * and the recording ends with the last valid block. */
+struct ColumnarHeader
+{
+  /** Magic bytes "PULSECOL". */
+  char     magic[8];
+  /** Format version. */
+  uint16_t version;
+  /** Size of the header in bytes. */
+  uint16_t headerSize;
+  /** Number of columns per block. */
+  uint16_t columns;
+  /** Sample period in ms. */
+  uint16_t period;
+  /** Start of the recording in ms since epoch (UTC). */
+  int64_t  startTime;
+  /** Serial number of the device (0-terminated, if shorter). */
+  char     serial[32];
+  /** Maximum number of rows per block. */
+  uint32_t rowsPerBlock;
+  uint8_t  reserved[4];
+};
+
+/** Header of a block. Version 1 blocks have no checksum, their header ends after @c size. */
+struct ColumnarBlockHeader
+{
+  /** Number of rows in the block. */
+  uint32_t rows;
+  /** Size of the block (excluding this header) in bytes. */
+  uint32_t size;
+  /** CRC-32 of @c rows and @c size followed by the block (excluding this header). */
+  uint32_t crc;
+  uint32_t reserved;
+};
+
+/** Header of a column within a block. */
+struct ColumnarColumn
+{
+  /** Minimum and maximum value of the column within the block (NaN values are ignored). */
+  double   min, max;
+  /** Size of the encoded data in bytes. */
+  uint32_t size;
+  uint32_t reserved;
+};
+
+
+/** Columns of a columnar recording. The first columns are integer columns (delta + zigzag +
+ * varint encoded), the remaining ones float columns (XOR encoded). */
+typedef enum {
+  COL_T = 0, COL_BASE, COL_IR, COL_RED, COL_FLAGS, COL_QUALITY,
+  COL_SPO2, COL_PULSE, COL_IR_MEAN, COL_IR_PULSE, COL_IR_STD,
+  COL_RED_MEAN, COL_RED_PULSE, COL_RED_STD, COL_RATIO,
+  COL_COUNT,
+  COL_FIRST_FLOAT = COL_SPO2
+} ColumnarColumnId;
+
+
+/** Writes a columnar recording along with its time index (see @c TimeIndexWriter), holding an
+ * entry per block. Complete blocks get written asynchronously (see @c AsyncWriter), whose buffers
+ * are sized to hold two blocks of the maximum encoded size. */
+class ColumnarWriter
+{
+public:
+  /** Current format version. */
+  const static uint16_t version = 2;
+  /** Default number of rows per block. */
+  const static uint32_t defaultRowsPerBlock = 4096;
+
+public:
+  ColumnarWriter(uint32_t rowsPerBlock=defaultRowsPerBlock);
+
+  /** Returns the maximum size in bytes of an encoded block of the given number of rows (including
+   * its headers), i.e., the size if no value compresses at all. */
+  static size_t maxBlockSize(uint32_t rows);
+
+  /** Creates the recording and writes the header. Returns @c false on error. */
+  bool open(const QString &filename, uint16_t period, int64_t startTime, const QString &serial);
+  /** Returns @c true if a recording is open. */
+  bool isOpen() const;
+  /** Appends a row. Returns @c false if a completed block got dropped. */
+  bool write(const BinaryLogRecord &record);
+  /** Writes the pending (incomplete) block and closes the recording and its index. */
+  void close();
+
+  /** Returns the writer (e.g., to set the sync policy or to obtain the drop counts). */
+  AsyncWriter &writer();
+  /** Returns the writer. */
+  const AsyncWriter &writer() const;
+
+protected:
+  /** Encodes the pending rows as a block and hands it over to the writer. */
+  bool _flush();
+
+protected:
+  AsyncWriter _file;
+  TimeIndexWriter _index;
+  /** Number of bytes and rows written. */
+  uint64_t _offset;
+  uint64_t _written;
+  uint32_t _rowsPerBlock;
+  /** Number of pending rows. */
+  uint32_t _rows;
+  IntEncoder _ints[COL_FIRST_FLOAT];
+  FloatEncoder _floats[COL_COUNT-COL_FIRST_FLOAT];
+  double _min[COL_COUNT], _max[COL_COUNT];
+  /** Reused block buffer. */
+  QByteArray _block;
+};
+
+
+/** Reader of columnar recordings.
+ *
+ * The file gets mapped into memory. The blocks are located by the time index of the recording (see
+ * @c TimeIndex), hence opening and seeking cost O(log n). Blocks not covered by the index (e.g.,
+ * after a crash, or if the index is missing) get indexed on opening by walking their headers.
+ * Blocks get decoded on demand, the per-block statistics allow to skip blocks in range queries. */
+class ColumnarReader
+{
+public:
+  /** Location and statistics of a block. */
+  struct Block {
+    /** Index of the first row of the block. */
+    size_t firstRow;
+    /** Number of rows. */
+    size_t rows;
+    /** Column headers within the mapped file. */
+    const ColumnarColumn *columns[COL_COUNT];
+    /** Encoded column data within the mapped file. */
+    const uint8_t *data[COL_COUNT];
+  };
+
+public:
+  ColumnarReader();
+  ~ColumnarReader();
+
+  /** Returns @c true if the given file starts with the columnar recording magic. */
+  static bool isColumnar(const QString &filename);
+
+  /** Maps the given recording. Returns @c false on error. */
+  bool open(const QString &filename);
+  /** Unmaps the file. */
+  void close();
+  /** Returns @c true if a recording is mapped. */
+  bool isOpen() const;
+
+  /** Returns the header. */
+  const ColumnarHeader &header() const;
+  /** Returns the total number of rows. */
+  size_t size() const;
+  /** Returns the size of the valid part of the file in bytes, i.e., the offset following the last
+   * valid block. Anything beyond is incomplete or corrupted (e.g., after a crash). The checksums
+   * of the blocks not covered by the time index get checked once, by @c open. */
+  size_t validSize() const;
+  /** Walks all blocks from the header on, checking their checksums. Returns the offset following
+   * the last block of the unbroken sequence of valid blocks. Unlike @c validSize, which only
+   * re-checks the blocks not covered by the time index, this reads the complete file. */
+  size_t verify() const;
+  /** Returns the number of blocks. */
+  size_t blockCount() const;
+  /** Locates the i-th block. Returns @c false if the block is truncated. The checksum does not
+   * get checked (see @c verify). */
+  bool block(size_t i, Block &block) const;
+  /** Returns the index of the first row at or after @c t ms. Returns the number of rows if there
+   * is none. */
+  size_t find(uint32_t t) const;
+  /** Returns the index of the block holding the given row. */
+  size_t findBlock(size_t row) const;
+
+  /** Decodes the given column of block @c i into @c out (which must hold the rows of the block).
+   * Returns @c false if the data is corrupted. */
+  bool decodeColumn(size_t i, ColumnarColumnId column, double *out) const;
+  /** Decodes all columns of block @c i into @c out (which must hold the rows of the block).
+   * Returns @c false if the data is corrupted. */
+  bool decodeBlock(size_t i, BinaryLogRecord *out) const;
+
+  /** Returns the indices of all blocks which may contain values of @c column within
+   * [lower, upper]. */
+  QVector<size_t> findBlocks(ColumnarColumnId column, double lower, double upper) const;
+
+protected:
+  /** Parses the block at the given offset, @c end is set to the offset following it. Returns
+   * @c false if the block is incomplete or, if @c checkCrc is set, corrupted (i.e., its checksum
+   * does not match). */
+  bool _parseBlock(size_t offset, size_t firstRow, Block &block, size_t &end,
+                   bool checkCrc) const;
+  /** Decodes the given column of the parsed block into @c out. Returns @c false if the data is
+   * corrupted. */
+  static bool _decodeColumn(const Block &block, ColumnarColumnId column, double *out);
+
+protected:
+  QFile _file;
+  uchar *_data;
+  /** The time index, holding an entry per block. */
+  TimeIndex _index;
+  size_t _rows;
+  /** Size of the block headers (depends on the version). */
+  size_t _blockHeaderSize;
+  /** Offset following the last valid block. */
+  size_t _end;
+};
+
+#endif // COLUMNAR_HH
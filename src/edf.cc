@@ -0,0 +1,257 @@
+#include "edf.hh"
+#include <QFile>
+#include <QDebug>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+// Offset of the number of data records within the header
+#define NUM_RECORDS_OFFSET 236
+
+
+/** Appends @c value to @c header, left-justified in a field of @c width characters. */
+static void
+field(QByteArray &header, const QByteArray &value, int width) {
+  QByteArray text = value.left(width);
+  // Only printable ASCII characters are allowed in the header
+  for (int i=0; i<text.size(); i++) {
+    if ((text[i] < 32) || (text[i] > 126))
+      text[i] = '_';
+  }
+  header.append(text);
+  header.append(QByteArray(width-text.size(), ' '));
+}
+
+/** Maps @c value linearly from [min, max] to [dmin, dmax] and clamps it. */
+static inline int16_t
+digital(double value, double min, double max, int dmin, int dmax) {
+  if (std::isnan(value))
+    return dmin;
+  double d = dmin + (value-min)*(dmax-dmin)/(max-min);
+  return int16_t(std::round(std::min(double(dmax), std::max(double(dmin), d))));
+}
+
+/** Formats a time in ms as an onset or duration in seconds. */
+static inline QByteArray
+seconds(uint32_t ms) {
+  return QByteArray::number(ms/1000) + "." + QByteArray::number(1000 + ms%1000).mid(1);
+}
+
+
+/** Definition of a signal. */
+typedef struct {
+  const char *label;
+  const char *dimension;
+  const char *physMin, *physMax;
+  int digMin, digMax;
+} SignalDef;
+
+static const SignalDef signalDefs[EDFWriter::SIG_COUNT] = {
+  { "IR",         "",    "0", "65535", -32768, 32767 },
+  { "RED",        "",    "0", "65535", -32768, 32767 },
+  { "SpO2",       "%",   "0", "100",        0, 10000 },
+  { "Pulse Rate", "bpm", "0", "300",        0, 30000 },
+  { "Quality",    "",    "0", "1",          0,   255 }
+};
+
+
+/* ********************************************************************************************* *
+ * EDFWriter
+ * ********************************************************************************************* */
+EDFWriter::EDFWriter(uint16_t period, uint16_t samplesPerRecord)
+  : _file(), _period(period), _samplesPerRecord(std::max(uint16_t(1), samplesPerRecord)),
+    _samples(0), _annotations(0), _t(0), _onset(0), _end(0), _offset(0), _records(0),
+    _droppedAnnotations(0)
+{
+  // pass...
+}
+
+bool
+EDFWriter::open(const QString &filename, const QDateTime &startTime, const QString &serial) {
+  if (! _file.open(filename))
+    return false;
+
+  static const char *months[] = { "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                  "JUL", "AUG", "SEP", "OCT", "NOV", "DEC" };
+  QDate date = startTime.date();
+  QTime time = startTime.time();
+  QByteArray equipment = "pulseOxi";
+  if (! serial.isEmpty())
+    equipment += "_" + serial.toLatin1().replace(' ', '_');
+
+  // Fixed part of the header
+  int ns = SIG_COUNT+1;
+  QByteArray header;
+  field(header, "0", 8);
+  field(header, "X X X X", 80);
+  field(header, "Startdate " + QByteArray::number(date.day()).rightJustified(2, '0') + "-" +
+        months[date.month()-1] + "-" + QByteArray::number(date.year()) + " X X " + equipment, 80);
+  field(header, startTime.toString("dd.MM.yy").toLatin1(), 8);
+  field(header, startTime.toString("hh.mm.ss").toLatin1(), 8);
+  field(header, QByteArray::number(256*(ns+1)), 8);
+  field(header, "EDF+D", 44);
+  field(header, "-1", 8);
+  field(header, seconds(uint32_t(_period)*_samplesPerRecord), 8);
+  field(header, QByteArray::number(ns), 4);
+  // Signal headers, each field for all signals in turn
+  for (int i=0; i<SIG_COUNT; i++) field(header, signalDefs[i].label, 16);
+  field(header, "EDF Annotations", 16);
+  for (int i=0; i<ns; i++) field(header, (i<SIG_COUNT) ? "Pulse oximeter" : "", 80);
+  for (int i=0; i<SIG_COUNT; i++) field(header, signalDefs[i].dimension, 8);
+  field(header, "", 8);
+  for (int i=0; i<SIG_COUNT; i++) field(header, signalDefs[i].physMin, 8);
+  field(header, "-1", 8);
+  for (int i=0; i<SIG_COUNT; i++) field(header, signalDefs[i].physMax, 8);
+  field(header, "1", 8);
+  for (int i=0; i<SIG_COUNT; i++) field(header, QByteArray::number(signalDefs[i].digMin), 8);
+  field(header, "-32768", 8);
+  for (int i=0; i<SIG_COUNT; i++) field(header, QByteArray::number(signalDefs[i].digMax), 8);
+  field(header, "32767", 8);
+  for (int i=0; i<ns; i++) field(header, "", 80);
+  for (int i=0; i<SIG_COUNT; i++) field(header, QByteArray::number(_samplesPerRecord), 8);
+  field(header, QByteArray::number(annotationSize/2), 8);
+  for (int i=0; i<ns; i++) field(header, "", 32);
+
+  // The header holds whole seconds, the remaining ms are added to all onsets
+  _offset  = time.msec();
+  _samples = 0; _end = 0; _records = 0; _droppedAnnotations = 0;
+  _record.resize(2*SIG_COUNT*_samplesPerRecord + annotationSize);
+  return _file.write(header);
+}
+
+bool
+EDFWriter::isOpen() const {
+  return _file.isOpen();
+}
+
+bool
+EDFWriter::write(const BinaryLogRecord &record) {
+  if (! _file.isOpen())
+    return false;
+
+  bool ok = true;
+  if (_samples && (record.t > (_t + _period + _period/2))) {
+    // Gap: Pad the current record up to the sample if it falls within the record, otherwise
+    // complete it and continue at the actual time (at the earliest once the record ended)
+    uint32_t onset = _t + _period;
+    size_t slot = (record.t - _onset + _period/2)/_period;
+    if (slot < _samplesPerRecord) {
+      _annotate(onset, "Gap", record.t-onset);
+      if (slot > _samples)
+        _pad(slot-_samples);
+    } else {
+      ok = _flush();
+      _startRecord(record.t);
+      _annotate(onset, "Gap", record.t-onset);
+    }
+  } else if (0 == _samples) {
+    _startRecord(record.t);
+  }
+
+  _store(_samples++, record);
+  if (record.flags & BinaryLogRecord::BEAT)
+    _annotate(record.t, "Beat");
+  _t = record.t;
+
+  if (_samples == _samplesPerRecord)
+    ok = _flush() && ok;
+  return ok;
+}
+
+void
+EDFWriter::close() {
+  if (! _file.isOpen())
+    return;
+  if (_samples)
+    _flush();
+  QString filename = _file.fileName();
+  _file.close();
+
+  if (_droppedAnnotations)
+    qDebug() << "EDF export" << filename << ":" << _droppedAnnotations << "annotations dropped.";
+  // Patch the number of data records
+  QFile file(filename);
+  QByteArray count;
+  field(count, QByteArray::number(_records), 8);
+  if ((! file.open(QIODevice::ReadWrite)) || (! file.seek(NUM_RECORDS_OFFSET)) ||
+      (count.size() != file.write(count))) {
+    qDebug() << "Cannot update the number of records of" << filename << ":" << file.errorString();
+  }
+}
+
+AsyncWriter &
+EDFWriter::writer() {
+  return _file;
+}
+
+const AsyncWriter &
+EDFWriter::writer() const {
+  return _file;
+}
+
+void
+EDFWriter::_startRecord(uint32_t t) {
+  _samples = 0;
+  _onset = std::max(t, _end);
+  // Time-keeping annotation, giving the onset of the record
+  QByteArray tal = "+" + seconds(_onset+_offset) + "\x14\x14";
+  char *annotations = _record.data() + 2*SIG_COUNT*_samplesPerRecord;
+  memset(annotations, 0, annotationSize);
+  memcpy(annotations, tal.constData(), tal.size());
+  _annotations = tal.size()+1;
+}
+
+void
+EDFWriter::_annotate(uint32_t onset, const char *text, uint32_t duration) {
+  QByteArray tal = "+" + seconds(onset+_offset);
+  if (duration)
+    tal += "\x15" + seconds(duration);
+  tal += "\x14" + QByteArray(text) + "\x14";
+  // Each TAL is terminated by a 0-byte
+  if ((_annotations + tal.size() + 1) > annotationSize) {
+    _droppedAnnotations++;
+    return;
+  }
+  char *annotations = _record.data() + 2*SIG_COUNT*_samplesPerRecord;
+  memcpy(annotations + _annotations, tal.constData(), tal.size());
+  _annotations += tal.size()+1;
+}
+
+void
+EDFWriter::_store(size_t i, const BinaryLogRecord &record) {
+  int16_t values[SIG_COUNT];
+  values[SIG_IR]      = int16_t(int(record.ir) - 32768);
+  values[SIG_RED]     = int16_t(int(record.red) - 32768);
+  values[SIG_SPO2]    = digital(record.spo2, 0, 100, 0, 10000);
+  values[SIG_PULSE]   = digital(record.pulse, 0, 300, 0, 30000);
+  values[SIG_QUALITY] = record.quality;
+  char *data = _record.data();
+  for (int s=0; s<SIG_COUNT; s++)
+    qToLittleEndian<qint16>(values[s], (uchar *)(data + 2*(s*_samplesPerRecord + i)));
+}
+
+void
+EDFWriter::_pad(size_t count) {
+  // The digital minimum of each signal (NaN maps to it) marks the samples as not measured
+  BinaryLogRecord padding;
+  memset(&padding, 0, sizeof(BinaryLogRecord));
+  padding.spo2 = padding.pulse = std::numeric_limits<float>::quiet_NaN();
+  _annotate(_onset + uint32_t(_period)*_samples, "Padding, not measured data",
+            uint32_t(_period)*count);
+  for (size_t i=0; i<count; i++)
+    _store(_samples++, padding);
+}
+
+bool
+EDFWriter::_flush() {
+  if (_samples < _samplesPerRecord)
+    _pad(_samplesPerRecord-_samples);
+  _samples = 0;
+  _end = _onset + uint32_t(_period)*_samplesPerRecord;
+  if (! _file.write(_record))
+    return false;
+  _records++;
+  return true;
+}
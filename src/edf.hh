@@ -0,0 +1,87 @@
+#ifndef EDF_HH
+#define EDF_HH
+
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+#include "asyncwriter.hh"
+#include "binarylog.hh"
+
+
+/** Streaming writer of EDF+ files.
+ *
+ * Exports the raw IR and RED intensities, the SpO2 and pulse rate estimates and the signal quality
+ * as EDF+ signals, and the heartbeats and gaps (e.g., due to a lost connection) as annotations.
+ * The samples of a data record are collected in a single buffer and written (asynchronously, see
+ * @c AsyncWriter) once the record is complete, hence the memory usage does not depend on the
+ * length of the recording. A gap within the span of the current record gets padded, a longer one
+ * completes the current record and starts a new one at the actual time (but not before the end of
+ * the previous one, hence the records never overlap). Thus, the file is written as discontinuous
+ * (EDF+D) with the onset of each record given by its time-keeping annotation. Padded samples hold
+ * the digital minimum of each signal and are annotated as not measured. The number of data
+ * records in the header is unknown (-1) while writing and gets patched on @c close. */
+class EDFWriter
+{
+public:
+  /** Signals of the file (excluding the annotations). */
+  typedef enum {
+    SIG_IR = 0, SIG_RED, SIG_SPO2, SIG_PULSE, SIG_QUALITY,
+    SIG_COUNT
+  } Signal;
+
+  /// Size of the annotation signal in bytes per record
+  const static uint16_t annotationSize = 256;
+
+public:
+  /** Constructor.
+   * @param period Specifies the sample period in ms.
+   * @param samplesPerRecord Specifies the number of samples per data record. */
+  EDFWriter(uint16_t period, uint16_t samplesPerRecord=40);
+
+  /** Creates the file and writes the header. Returns @c false on error. */
+  bool open(const QString &filename, const QDateTime &startTime, const QString &serial);
+  /** Returns @c true if a file is open. */
+  bool isOpen() const;
+  /** Appends a sample, the beat flag of the record yields a beat annotation. Returns @c false if
+   * a completed data record got dropped. */
+  bool write(const BinaryLogRecord &record);
+  /** Writes the pending (incomplete) record, closes the file and patches the number of records
+   * in the header. */
+  void close();
+
+  /** Returns the writer (e.g., to set the sync policy or to obtain the drop counts). */
+  AsyncWriter &writer();
+  /** Returns the writer. */
+  const AsyncWriter &writer() const;
+
+protected:
+  /** Starts a new record at the given time in ms, but not before the end of the previous one. */
+  void _startRecord(uint32_t t);
+  /** Adds an annotation at @c onset (in ms) to the current record. */
+  void _annotate(uint32_t onset, const char *text, uint32_t duration=0);
+  /** Stores the given sample at the given index of the current record. */
+  void _store(size_t i, const BinaryLogRecord &record);
+  /** Appends @c count padding samples to the current record and annotates them. */
+  void _pad(size_t count);
+  /** Pads and hands the current record over to the writer. */
+  bool _flush();
+
+protected:
+  AsyncWriter _file;
+  uint16_t _period;
+  uint16_t _samplesPerRecord;
+  /** Buffer of the current record, the samples of each signal are followed by the annotations. */
+  QByteArray _record;
+  /** Number of samples and bytes of annotations in the current record. */
+  uint16_t _samples;
+  uint16_t _annotations;
+  /** Time of the last sample, onset of the current record and end of the previous one in ms. */
+  uint32_t _t, _onset, _end;
+  /** Milliseconds of the start time, added to all onsets as the header holds whole seconds. */
+  uint16_t _offset;
+  /** Number of records written and annotations dropped (as a record was full). */
+  qint64 _records;
+  quint64 _droppedAnnotations;
+};
+
+#endif // EDF_HH
@@ -6,20 +6,30 @@
 #include <iostream>
 
 
-template<uint16_t _size>
+/** Sample type of the signal processing. Float by default, the build option PULSE_DOUBLE
+ * selects double precision (e.g., for offline reference runs). */
+#ifdef PULSE_DOUBLE
+typedef double Scalar;
+#else
+typedef float Scalar;
+#endif
+
+
+template<uint16_t _size, class T=Scalar>
 class LowPassKernel
 {
 public:
+  typedef T Type;
   const static uint16_t size = _size;
 
 public:
-  LowPassKernel(float Fc)
+  LowPassKernel(T Fc)
     : _Fc(Fc)
   {
     // pass...
   }
 
-  float eval(float t) const {
+  T eval(T t) const {
     if (0 == t) {
       return 2*_Fc;
     }
@@ -27,24 +37,25 @@ public:
   }
 
 protected:
-  float _Fc;
+  T _Fc;
 };
 
 
-template<uint16_t _size>
+template<uint16_t _size, class T=Scalar>
 class HighPassKernel
 {
 public:
+  typedef T Type;
   const static uint16_t size = _size;
 
 public:
-  HighPassKernel(float Fc)
+  HighPassKernel(T Fc)
     : _Fc(Fc)
   {
     // pass...
   }
 
-  float eval(float t) const {
+  T eval(T t) const {
     if (0 == t) {
       return 1./_Fc - 2*_Fc;
     }
@@ -52,24 +63,25 @@ public:
   }
 
 protected:
-  float _Fc;
+  T _Fc;
 };
 
 
-template<uint16_t _size>
+template<uint16_t _size, class T=Scalar>
 class BandPassKernel
 {
 public:
+  typedef T Type;
   const static uint16_t size = _size;
 
 public:
-  BandPassKernel(float Fl, float Fu)
+  BandPassKernel(T Fl, T Fu)
     : _Fl(Fl), _Fu(Fu)
   {
     // pass...
   }
 
-  float eval(float t) const {
+  T eval(T t) const {
     if (0 == t) {
       return 2*_Fu-2*_Fl;
     }
@@ -78,8 +90,8 @@ public:
   }
 
 protected:
-  float _Fl;
-  float _Fu;
+  T _Fl;
+  T _Fu;
 };
 
 
@@ -87,8 +99,8 @@ template <uint16_t size>
 class WelchWindow
 {
 public:
-  static float eval(size_t i) {
-    float x  = (i-float(size-1)/2)/(float(size-1)/2);
+  static double eval(size_t i) {
+    double x  = (i-double(size-1)/2)/(double(size-1)/2);
     return 1. - x*x;
   }
 };
@@ -98,6 +110,7 @@ template<class Kernel, class Window=WelchWindow<Kernel::size> >
 class FIR
 {
 public:
+  typedef typename Kernel::Type Type;
   const static uint16_t size = Kernel::size;
   const static uint16_t mask = size-1;
 
@@ -111,7 +124,7 @@ public:
     }
   }
 
-  float apply(float value) {
+  Type apply(Type value) {
     _buffer[_idx] = value;
     value = 0;
     for (size_t i=0; i<size; i++) {
@@ -121,10 +134,137 @@ public:
     return value;
   }
 
+  /** Clears the filter state. */
+  void reset() {
+    for (int i=0; i<size; i++)
+      _buffer[i] = 0;
+    _idx = 0;
+  }
+
+protected:
+  Type _kernel[size];
+  Type _buffer[size];
+  uint16_t _idx;
+};
+
+
+/** Polyphase decimating FIR filter.
+ *
+ * Filters the input with the given (anti-aliasing) kernel and keeps only every @c _factor-th
+ * output sample. The convolution is evaluated only for the samples kept, hence the cost per input
+ * sample is @c size/_factor multiply-adds. The kernel size must be a power of 2. */
+template<class Kernel, uint16_t _factor, class Window=WelchWindow<Kernel::size> >
+class Decimator
+{
+public:
+  typedef typename Kernel::Type Type;
+  const static uint16_t size   = Kernel::size;
+  const static uint16_t mask   = size-1;
+  const static uint16_t factor = _factor;
+
+public:
+  Decimator(const Kernel &kernel)
+    : _idx(0), _phase(0)
+  {
+    for (int i=0; i<size; i++) {
+      _kernel[i] = kernel.eval(i-size/2)*Window::eval(i);
+      _buffer[i] = 0;
+    }
+  }
+
+  /** Processes the given input sample. Returns @c true and stores the output sample in @c out
+   * every @c factor-th input sample. */
+  bool apply(Type value, Type &out) {
+    _buffer[_idx] = value;
+    _idx = (_idx+1)&mask;
+    if (++_phase < factor)
+      return false;
+    _phase = 0;
+    out = 0;
+    for (size_t i=0; i<size; i++) {
+      out += _kernel[i]*_buffer[(_idx+i)&mask];
+    }
+    return true;
+  }
+
+  /** Clears the filter state. */
+  void reset() {
+    for (int i=0; i<size; i++)
+      _buffer[i] = 0;
+    _idx = _phase = 0;
+  }
+
+protected:
+  Type _kernel[size];
+  Type _buffer[size];
+  uint16_t _idx;
+  uint16_t _phase;
+};
+
+
+/** Polyphase interpolating FIR filter.
+ *
+ * Upsamples the input by @c _factor and filters the result with the given (anti-imaging)
+ * kernel. Each low-rate input sample gets pushed with @c push, the @c _factor high-rate output
+ * samples get obtained by successive calls to @c apply. Each output sample is computed from
+ * a single phase of the kernel, hence costs only @c size/_factor multiply-adds. The kernel size
+ * must be a power of 2 and a multiple of @c _factor. */
+template<class Kernel, uint16_t _factor, class Window=WelchWindow<Kernel::size> >
+class Interpolator
+{
+public:
+  typedef typename Kernel::Type Type;
+  const static uint16_t size   = Kernel::size;
+  const static uint16_t factor = _factor;
+  const static uint16_t taps   = size/factor;
+  const static uint16_t mask   = taps-1;
+
+public:
+  Interpolator(const Kernel &kernel)
+    : _idx(0), _phase(0)
+  {
+    // Re-arrange kernel by phase, scale by factor to preserve the gain
+    for (int p=0; p<factor; p++) {
+      for (int j=0; j<taps; j++) {
+        int i = p + j*factor;
+        _kernel[p][j] = factor*kernel.eval(i-size/2)*Window::eval(i);
+      }
+    }
+    for (int j=0; j<taps; j++)
+      _buffer[j] = 0;
+  }
+
+  /** Pushes the next low-rate input sample. */
+  void push(Type value) {
+    _idx = (_idx+1)&mask;
+    _buffer[_idx] = value;
+    _phase = 0;
+  }
+
+  /** Returns the next high-rate output sample. */
+  Type apply() {
+    Type value = 0;
+    const Type *kernel = _kernel[_phase];
+    for (size_t j=0; j<taps; j++) {
+      value += kernel[j]*_buffer[(_idx-j)&mask];
+    }
+    if (_phase < (factor-1))
+      _phase++;
+    return value;
+  }
+
+  /** Clears the filter state. */
+  void reset() {
+    for (int j=0; j<taps; j++)
+      _buffer[j] = 0;
+    _idx = _phase = 0;
+  }
+
 protected:
-  float _kernel[size];
-  float _buffer[size];
+  Type _kernel[factor][taps];
+  Type _buffer[taps];
   uint16_t _idx;
+  uint16_t _phase;
 };
 
 
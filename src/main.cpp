@@ -10,6 +10,15 @@ int main(int argc, char *argv[])
 
   Settings settings;
   Pulse pulse(settings.swapChannels());
+  pulse.setMedianDC(settings.medianDC());
+  if (! settings.calibrationFile().isEmpty())
+    pulse.loadCalibration(settings.calibrationFile());
+  if (settings.logSyncInterval() > 0)
+    pulse.setLogSyncPolicy(AsyncWriter::SYNC_PERIODIC, 1000*settings.logSyncInterval());
+  pulse.setLogFormat(settings.logDelimiter(), settings.logPrecision());
+  pulse.setLogRotation(settings.logSegmentSize()*(1<<20), settings.logSegmentDuration()*3600e3);
+  pulse.setLogRetention(settings.logRetentionSize()*(1<<20),
+                        settings.logRetentionAge()*24*3600e3);
 
   MainWindow mainwin(pulse, settings);
   mainwin.show();
@@ -4,12 +4,18 @@
 #include <QFileDialog>
 #include <QToolButton>
 #include <QIcon>
+#include <QStatusBar>
+#include <QFileInfo>
+#include <QDateTime>
+#include <limits>
 #include "settingsdialog.hh"
 #include "aboutdialog.hh"
 
 
 MainWindow::MainWindow(Pulse &pulse, Settings &settings, QWidget *parent)
-  : QMainWindow(parent), _pulse(pulse), _settings(settings), _plot(0), _beep()
+  : QMainWindow(parent), _pulse(pulse), _settings(settings), _plot(0),
+    _render(settings.maxFps()), _beep(), _logDropped(0),
+    _pulseRangeTime(-std::numeric_limits<double>::infinity())
 {
   //setWindowFlags(windowFlags() | Qt::CustomizeWindowHint | Qt::WindowStaysOnTopHint);
   setMinimumSize(800, 480);
@@ -33,6 +39,10 @@ MainWindow::MainWindow(Pulse &pulse, Settings &settings, QWidget *parent)
   _log->setChecked(false);
   _log->setToolTip(tr("Start/stop logging measurements to a file."));
   toolbar->addWidget(_log);
+
+  QAction *openAct = toolbar->addAction(
+        QIcon("://icons/pulse.png"), tr("Open recording"), this, SLOT(_onOpenRecording()));
+  openAct->setToolTip(tr("View a saved recording."));
   toolbar->addSeparator();
 
   _soundButton = new QToolButton();
@@ -73,30 +83,57 @@ MainWindow::MainWindow(Pulse &pulse, Settings &settings, QWidget *parent)
   _plot->yAxis2->setTickLabelColor(Qt::red);
   _plot->yAxis2->setLabel(tr("Pulse [BPM]"));
 
-  _spo2Graph = _plot->addGraph();
+  _spo2Graph = new RingGraph(_plot->xAxis, _plot->yAxis);
+  _plot->addPlottable(_spo2Graph);
   _spo2Graph->setPen(QColor(Qt::blue));
 
-  _pulseGraph = _plot->addGraph(0, _plot->yAxis2);
+  _pulseGraph = new RingGraph(_plot->xAxis, _plot->yAxis2);
+  _plot->addPlottable(_pulseGraph);
   _pulseGraph->setPen(QColor(Qt::red));
 
+  color = Qt::blue; color.setAlpha(32);
+  _spo2Upper = new RingGraph(_plot->xAxis, _plot->yAxis);
+  _plot->addPlottable(_spo2Upper);
+  _spo2Lower = new RingGraph(_plot->xAxis, _plot->yAxis);
+  _plot->addPlottable(_spo2Lower);
+  _spo2Upper->setPen(Qt::NoPen);
+  _spo2Lower->setPen(Qt::NoPen);
+  _spo2Lower->setBrush(color);
+  _spo2Lower->setChannelFillGraph(_spo2Upper);
+  color = Qt::red; color.setAlpha(32);
+  _pulseUpper = new RingGraph(_plot->xAxis, _plot->yAxis2);
+  _plot->addPlottable(_pulseUpper);
+  _pulseLower = new RingGraph(_plot->xAxis, _plot->yAxis2);
+  _plot->addPlottable(_pulseLower);
+  _pulseUpper->setPen(Qt::NoPen);
+  _pulseLower->setPen(Qt::NoPen);
+  _pulseLower->setBrush(color);
+  _pulseLower->setChannelFillGraph(_pulseUpper);
+
   _pulsePlot = new QCustomPlot(this);
   _pulsePlot->setVisible(_settings.pulsePlotVisible());
   _pulsePlot->yAxis->setLabel(tr("Pulse signal"));
   _pulsePlot->yAxis->setRange(-1, 1);
   _pulsePlot->xAxis->setRange(0, _settings.pulsePlotDuration());
-  _irPulseGraph = _pulsePlot->addGraph();
-  _irStdGraph   = _pulsePlot->addGraph();
+  _irPulseGraph = new RingGraph(_pulsePlot->xAxis, _pulsePlot->yAxis);
+  _pulsePlot->addPlottable(_irPulseGraph);
+  _irStdGraph = new RingGraph(_pulsePlot->xAxis, _pulsePlot->yAxis);
+  _pulsePlot->addPlottable(_irStdGraph);
   color = Qt::blue;
   _irPulseGraph->setPen(color);
   color.setAlpha(64);
   _irStdGraph->setPen(color);
-  _redPulseGraph = _pulsePlot->addGraph();
-  _redStdGraph   = _pulsePlot->addGraph();
+  _redPulseGraph = new RingGraph(_pulsePlot->xAxis, _pulsePlot->yAxis);
+  _pulsePlot->addPlottable(_redPulseGraph);
+  _redStdGraph = new RingGraph(_pulsePlot->xAxis, _pulsePlot->yAxis);
+  _pulsePlot->addPlottable(_redStdGraph);
   color = Qt::red;
   _redPulseGraph->setPen(color);
   color.setAlpha(64);
   _redStdGraph->setPen(color);
 
+  _setScrolling(true);
+
   QWidget *panel = new QWidget();
   QVBoxLayout *layout = new QVBoxLayout();
   layout->addWidget(_plot, 2);
@@ -114,6 +151,7 @@ MainWindow::MainWindow(Pulse &pulse, Settings &settings, QWidget *parent)
   connect(&_pulse, SIGNAL(measurement()), this, SLOT(_onUpdate()));
   connect(_start, SIGNAL(toggled(bool)), this, SLOT(_onStart(bool)));
   connect(_log, SIGNAL(toggled(bool)), this, SLOT(_onLog(bool)));
+  connect(_plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(_onViewRangeChanged(QCPRange)));
   connect(_soundButton, SIGNAL(toggled(bool)), this, SLOT(_onSoundToggled(bool)));
   connect(&_pulse, SIGNAL(pulseEvent()), &_beep, SLOT(play()));
 }
@@ -121,40 +159,59 @@ MainWindow::MainWindow(Pulse &pulse, Settings &settings, QWidget *parent)
 void
 MainWindow::_onUpdate() {
   double t  = _pulse.t();
-  _spo2Graph->addData(t, _pulse.SpO2());
-  _pulseGraph->addData(t, _pulse.pulse());
+  // Only plot estimates derived from a valid signal
+  if (_pulse.isValid()) {
+    _spo2Graph->addData(t, _pulse.SpO2());
+    _spo2Upper->addData(t, _pulse.SpO2()+_pulse.SpO2Std());
+    _spo2Lower->addData(t, _pulse.SpO2()-_pulse.SpO2Std());
+    _pulseGraph->addData(t, _pulse.pulse());
+    _pulseUpper->addData(t, _pulse.pulse()+_pulse.pulseStd());
+    _pulseLower->addData(t, _pulse.pulse()-_pulse.pulseStd());
+  }
 
   _irPulseGraph->addData(t, _pulse.irPulse());
-  _irPulseGraph->rescaleValueAxis(false,false);
   _irStdGraph->addData(t, _pulse.irStd());
-  _irStdGraph->rescaleValueAxis(true,false);
   _redPulseGraph->addData(t, _pulse.redPulse());
-  _redPulseGraph->rescaleValueAxis(true,false);
   _redStdGraph->addData(t, _pulse.redStd());
-  _redStdGraph->rescaleValueAxis(true,false);
+  _rescalePulsePlot();
+
+  // Report if the disk cannot keep up with the logging
+  quint64 dropped = _pulse.logDropped();
+  if (dropped != _logDropped) {
+    _logDropped = dropped;
+    statusBar()->showMessage(tr("Disk too slow, %1 log entries dropped.").arg(dropped));
+  }
 
   _applySettings();
 }
 
 void
 MainWindow::_applySettings() {
-  double tMax = std::ceil(_pulse.t());
-  _spo2Graph->removeDataBefore(_pulse.t()-_settings.plotDuration());
-  _pulseGraph->removeDataBefore(_pulse.t()-_settings.plotDuration());
-  _irPulseGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
-  _irStdGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
-  _redPulseGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
-  _redStdGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
-
-  _plot->xAxis->setRange(tMax-_settings.plotDuration(), tMax);
+  if (_view.isOpen()) {
+    // The visible window of the recording is set by dragging and zooming
+    _loadView();
+  } else {
+    double tMax = std::ceil(_pulse.t());
+    _spo2Graph->removeDataBefore(_pulse.t()-_settings.plotDuration());
+    _pulseGraph->removeDataBefore(_pulse.t()-_settings.plotDuration());
+    _spo2Upper->removeDataBefore(_pulse.t()-_settings.plotDuration());
+    _spo2Lower->removeDataBefore(_pulse.t()-_settings.plotDuration());
+    _pulseUpper->removeDataBefore(_pulse.t()-_settings.plotDuration());
+    _pulseLower->removeDataBefore(_pulse.t()-_settings.plotDuration());
+    _irPulseGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
+    _irStdGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
+    _redPulseGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
+    _redStdGraph->removeDataBefore(_pulse.t()-_settings.pulsePlotDuration());
+    _plot->xAxis->setRange(tMax-_settings.plotDuration(), tMax);
+    _pulsePlot->xAxis->setRange(tMax-_settings.pulsePlotDuration(), tMax);
+  }
+
   _plot->yAxis->setRange(_settings.minSpO2(), _settings.maxSpO2());
   _plot->yAxis2->setRange(_settings.minPulse(), _settings.maxPulse());
-  _pulsePlot->xAxis->setRange(tMax-_settings.pulsePlotDuration(), tMax);
-
   _pulsePlot->setVisible(_settings.pulsePlotVisible());
-  _plot->replot();
+  _render.update(_plot);
   if (_settings.pulsePlotVisible()) {
-    _pulsePlot->replot();
+    _render.update(_pulsePlot);
   }
 
   if (_settings.pulseBeepEnabled()) {
@@ -185,6 +242,7 @@ MainWindow::_onConnectionLoss() {
 void
 MainWindow::_onStart(bool start) {
   if (start) {
+    _closeRecording();
     _pulse.start();
     _start->setText(tr("Stop"));
     _start->setIcon(QIcon("://icons/stop.png"));
@@ -194,7 +252,11 @@ MainWindow::_onStart(bool start) {
     _start->setIcon(QIcon("://icons/play.png"));
     // Reset plots
     _spo2Graph->clearData();
+    _spo2Upper->clearData();
+    _spo2Lower->clearData();
     _pulseGraph->clearData();
+    _pulseUpper->clearData();
+    _pulseLower->clearData();
     _irPulseGraph->clearData();
     _irStdGraph->clearData();
     _redPulseGraph->clearData();
@@ -206,17 +268,142 @@ void
 MainWindow::_onLog(bool log) {
   if (log) {
     QString filename = QFileDialog::getSaveFileName(
-          this, tr("Log to"), "", tr("*.csv *.txt (Comma separated values)"));
+          this, tr("Log to"), "",
+          tr("*.csv *.txt (Comma separated values);;*.plog (Binary log);;"
+             "*.pcol (Compressed recording);;*.praw (Raw recording);;*.edf (EDF+)"));
     if (filename.isEmpty()) {
       _log->setChecked(false);
       return;
     }
-    _pulse.logTo(filename);
+    if (! _pulse.logTo(filename)) {
+      QMessageBox::warning(this, tr("Cannot open log"),
+                           tr("Cannot open log file %1.").arg(filename));
+      _log->setChecked(false);
+    }
   } else {
     _pulse.closeLog();
   }
 }
 
+void
+MainWindow::_onOpenRecording() {
+  QString filename = QFileDialog::getOpenFileName(
+        this, tr("Open recording"), "",
+        tr("*.plog *.pcol *.praw (Recordings)"));
+  if (filename.isEmpty())
+    return;
+  // The recording replaces the live view
+  if (_start->isChecked())
+    _start->setChecked(false);
+  if (! _view.open(filename, _pulse.calibration(), _settings.medianDC())) {
+    QMessageBox::warning(this, tr("Cannot open recording"),
+                         tr("Cannot open recording %1.").arg(filename));
+    _closeRecording();
+    return;
+  }
+
+  setWindowTitle(tr("Pulse - %1").arg(QFileInfo(filename).fileName()));
+  _setScrolling(false);
+  _plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+  _plot->axisRect()->setRangeDrag(Qt::Horizontal);
+  _plot->axisRect()->setRangeZoom(Qt::Horizontal);
+  {
+    // Show the entire recording, loaded once by _applySettings
+    QSignalBlocker blocker(_plot->xAxis);
+    _plot->xAxis->setRange(0, std::max(1., std::ceil(_view.duration()/60e3)));
+  }
+  _applySettings();
+}
+
+void
+MainWindow::_onViewRangeChanged(const QCPRange &range) {
+  Q_UNUSED(range);
+  if (! _view.isOpen())
+    return;
+  // The plot gets replotted by the drag or zoom interaction
+  _loadView();
+  if (_settings.pulsePlotVisible())
+    _render.update(_pulsePlot);
+}
+
+void
+MainWindow::_loadView() {
+  QCPRange range = _plot->xAxis->range();
+  double from = std::max(0., range.lower*60e3);
+  double to = std::min(double(std::numeric_limits<uint32_t>::max()),
+                       std::max(0., range.upper*60e3)+1);
+  bool detailed = _view.load(uint32_t(from), uint32_t(to), _plot->axisRect()->width());
+
+  _spo2Graph->setData(_view.spo2().t, _view.spo2().value);
+  _spo2Upper->setData(_view.spo2().t, _view.spo2().max);
+  _spo2Lower->setData(_view.spo2().t, _view.spo2().min);
+  _pulseGraph->setData(_view.pulse().t, _view.pulse().value);
+  _pulseUpper->setData(_view.pulse().t, _view.pulse().max);
+  _pulseLower->setData(_view.pulse().t, _view.pulse().min);
+  // The pulse signals are shown at full resolution only
+  _irPulseGraph->setData(_view.irPulse().t, _view.irPulse().value);
+  _redPulseGraph->setData(_view.redPulse().t, _view.redPulse().value);
+  _irStdGraph->clearData();
+  _redStdGraph->clearData();
+  _pulsePlot->xAxis->setRange(range);
+  if (detailed) {
+    _irPulseGraph->rescaleValueAxis(false);
+    _redPulseGraph->rescaleValueAxis(true);
+  }
+
+  QDateTime start = QDateTime::fromMSecsSinceEpoch(_view.startTime() + int64_t(from));
+  if (detailed)
+    statusBar()->showMessage(tr("From %1.").arg(start.toString(Qt::ISODate)));
+  else
+    statusBar()->showMessage(tr("From %1, zoom in for the pulse signal.")
+                             .arg(start.toString(Qt::ISODate)));
+}
+
+void
+MainWindow::_closeRecording() {
+  _view.close();
+  setWindowTitle(tr("Pulse"));
+  _setScrolling(true);
+  _plot->setInteractions(QCP::Interactions());
+  _spo2Graph->clearData();
+  _spo2Upper->clearData();
+  _spo2Lower->clearData();
+  _pulseGraph->clearData();
+  _pulseUpper->clearData();
+  _pulseLower->clearData();
+  _irPulseGraph->clearData();
+  _redPulseGraph->clearData();
+  _pulseRangeTime = -std::numeric_limits<double>::infinity();
+  statusBar()->clearMessage();
+}
+
+void
+MainWindow::_setScrolling(bool enabled) {
+  _spo2Graph->setScrolling(enabled);
+  _pulseGraph->setScrolling(enabled);
+  _irPulseGraph->setScrolling(enabled);
+  _irStdGraph->setScrolling(enabled);
+  _redPulseGraph->setScrolling(enabled);
+  _redStdGraph->setScrolling(enabled);
+}
+
+void
+MainWindow::_rescalePulsePlot() {
+  // Any change of the value range re-renders the scrolling graphs (see RingGraph::setScrolling),
+  // hence the range widens to fit new extrema but shrinks at most once per window
+  QCPRange range = _pulsePlot->yAxis->range();
+  _irPulseGraph->rescaleValueAxis(false);
+  _irStdGraph->rescaleValueAxis(true);
+  _redPulseGraph->rescaleValueAxis(true);
+  _redStdGraph->rescaleValueAxis(true);
+  double t = _pulse.t();
+  // A restarted measurement starts over with a tight range
+  if ((t < _pulseRangeTime) || ((t-_pulseRangeTime) >= _settings.pulsePlotDuration()))
+    _pulseRangeTime = t;
+  else
+    _pulsePlot->yAxis->setRange(_pulsePlot->yAxis->range().expanded(range));
+}
+
 void
 MainWindow::_onSoundToggled(bool on) {
   _settings.setPulseBeepEnabled(on);
@@ -228,8 +415,21 @@ MainWindow::_onSoundToggled(bool on) {
 void
 MainWindow::_onSettings() {
   SettingsDialog dialog(_settings);
-  if (QDialog::Accepted == dialog.exec())
+  if (QDialog::Accepted == dialog.exec()) {
+    _pulse.loadCalibration(_settings.calibrationFile());
+    _pulse.setMedianDC(_settings.medianDC());
+    if (_settings.logSyncInterval() > 0)
+      _pulse.setLogSyncPolicy(AsyncWriter::SYNC_PERIODIC, 1000*_settings.logSyncInterval());
+    else
+      _pulse.setLogSyncPolicy(AsyncWriter::SYNC_NEVER);
+    _pulse.setLogFormat(_settings.logDelimiter(), _settings.logPrecision());
+    _render.setMaxFps(_settings.maxFps());
+    _pulse.setLogRotation(_settings.logSegmentSize()*(1<<20),
+                          _settings.logSegmentDuration()*3600e3);
+    _pulse.setLogRetention(_settings.logRetentionSize()*(1<<20),
+                           _settings.logRetentionAge()*24*3600e3);
     _applySettings();
+  }
 }
 
 void
@@ -4,7 +4,10 @@
 #include <QMainWindow>
 #include "pulse.h"
 #include "qcustomplot.hh"
+#include "ringgraph.hh"
 #include "settings.hh"
+#include "recordingview.hh"
+#include "renderscheduler.hh"
 #include <QToolButton>
 #include <QSoundEffect>
 
@@ -21,11 +24,26 @@ protected slots:
   void _onUpdate();
   void _onStart(bool start);
   void _onLog(bool log);
+  /** Opens a saved recording for viewing. */
+  void _onOpenRecording();
+  /** Loads the visible window of the recording being viewed. */
+  void _onViewRangeChanged(const QCPRange &range);
   void _onSoundToggled(bool on);
   void _onSettings();
   void _applySettings();
   void _onAbout();
 
+protected:
+  /** Leaves the view of a saved recording and returns to the live view. */
+  void _closeRecording();
+  /** Loads the visible window of the recording being viewed into the plots. */
+  void _loadView();
+  /** Enables the scrolling mode of the graphs (see @c RingGraph::setScrolling) for the live view,
+   * disables it for viewing recordings. */
+  void _setScrolling(bool enabled);
+  /** Fits the value axis of the live pulse plot to the pulse signals. */
+  void _rescalePulsePlot();
+
 protected:
   Pulse &_pulse;
   Settings &_settings;
@@ -35,16 +53,31 @@ protected:
   QToolButton *_soundButton;
 
   QCustomPlot *_plot;
-  QCPGraph *_spo2Graph;
-  QCPGraph *_pulseGraph;
+  RingGraph *_spo2Graph;
+  RingGraph *_pulseGraph;
+  /** Uncertainty bands (+/- 1 standard deviation) of the SpO2 and pulse rate estimates. */
+  RingGraph *_spo2Upper;
+  RingGraph *_spo2Lower;
+  RingGraph *_pulseUpper;
+  RingGraph *_pulseLower;
 
   QCustomPlot *_pulsePlot;
-  QCPGraph *_irPulseGraph;
-  QCPGraph *_irStdGraph;
-  QCPGraph *_redPulseGraph;
-  QCPGraph *_redStdGraph;
+  RingGraph *_irPulseGraph;
+  RingGraph *_irStdGraph;
+  RingGraph *_redPulseGraph;
+  RingGraph *_redStdGraph;
+
+  /** The saved recording being viewed (if any). While viewing, the plots can be dragged and
+   * zoomed horizontally, the live measurement is stopped. */
+  RecordingView _view;
+  /** Replots the plots at most once per frame. */
+  RenderScheduler _render;
 
   QSoundEffect _beep;
+  /** Number of log entries dropped so far. */
+  quint64 _logDropped;
+  /** Time (in minutes) the value axis of the pulse plot was last fitted tightly. */
+  double _pulseRangeTime;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,105 @@
+#ifndef MEDIAN_HH
+#define MEDIAN_HH
+
+#include <set>
+#include <cinttypes>
+#include <cstddef>
+#include "fir.hh"
+
+
+/** Sliding-window percentile filter.
+ *
+ * Returns the @c p-th percentile of the last @c _size input samples. Unlike the sinc low-pass
+ * filters, a single spike (e.g., a motion artifact) does not drag the output around as long as
+ * less than (1-p) (respectively p) of the window is affected. The window is kept as two ordered
+ * multisets, the lower one holding the samples up to the percentile. Hence each sample costs
+ * O(log size) operations. The interface matches @c FIR, i.e., it can be wrapped into a pipeline
+ * stage using @c Filter. Like the FIR filters, the output is delayed by @c _size/2 samples. */
+template<uint16_t _size, class T=Scalar>
+class RunningPercentile
+{
+public:
+  typedef T Type;
+  const static uint16_t size = _size;
+
+public:
+  /** Constructor.
+   * @param p Specifies the percentile in [0,1]. */
+  RunningPercentile(double p)
+    : _p(p)
+  {
+    reset();
+  }
+
+  T apply(T value) {
+    // drop the oldest sample once the window is full
+    if (_count == size) {
+      T old = _buffer[_idx];
+      typename std::multiset<T>::iterator item = _lower.end();
+      if ((! _lower.empty()) && (old <= *_lower.rbegin()))
+        item = _lower.find(old);
+      if (_lower.end() != item)
+        _lower.erase(item);
+      else
+        _upper.erase(_upper.find(old));
+    } else {
+      _count++;
+    }
+    _buffer[_idx] = value;
+    _idx = (_idx+1) % size;
+
+    if (_lower.empty() || (value <= *_lower.rbegin()))
+      _lower.insert(value);
+    else
+      _upper.insert(value);
+
+    // re-balance, such that the lower set holds the samples up to the percentile
+    size_t k = size_t(_p*(_count-1)) + 1;
+    while (_lower.size() > k) {
+      typename std::multiset<T>::iterator last = --_lower.end();
+      _upper.insert(*last);
+      _lower.erase(last);
+    }
+    while ((_lower.size() < k) && (! _upper.empty())) {
+      _lower.insert(*_upper.begin());
+      _upper.erase(_upper.begin());
+    }
+    return *_lower.rbegin();
+  }
+
+  /** Clears the filter state. */
+  void reset() {
+    for (int i=0; i<size; i++)
+      _buffer[i] = 0;
+    _lower.clear();
+    _upper.clear();
+    _idx = _count = 0;
+  }
+
+protected:
+  /** Percentile in [0,1]. */
+  double _p;
+  /** Samples in the window in order of arrival. */
+  T _buffer[size];
+  /** Samples up to the percentile. */
+  std::multiset<T> _lower;
+  /** Samples above the percentile. */
+  std::multiset<T> _upper;
+  uint16_t _idx;
+  uint16_t _count;
+};
+
+
+/** Sliding-window median filter. */
+template<uint16_t _size, class T=Scalar>
+class RunningMedian: public RunningPercentile<_size, T>
+{
+public:
+  RunningMedian()
+    : RunningPercentile<_size, T>(0.5)
+  {
+    // pass...
+  }
+};
+
+#endif // MEDIAN_HH
@@ -0,0 +1,123 @@
+#include "morphology.hh"
+#include <cmath>
+#include <limits>
+
+#define NaN std::numeric_limits<float>::quiet_NaN()
+
+
+Morphology::Morphology(uint16_t period)
+  : _period(period)
+{
+  reset();
+}
+
+void
+Morphology::reset() {
+  for (int i=0; i<maxBeatSize; i++) {
+    _wave[i] = 0; _time[i] = 0;
+  }
+  _count = 0;
+  _lastDetection = _lastFoot = 0;
+  _hasDetection = _hasFoot = false;
+  _features.t = 0;
+  _features.interval = _features.perfusion = _features.riseTime = 0;
+  _features.notchTime = _features.notchHeight = NaN;
+  for (int i=0; i<5; i++)
+    _features.apg[i] = NaN;
+}
+
+bool
+Morphology::update(double t, Scalar dc, Scalar ac, bool beat) {
+  // The pulse wave is inverse to the intensity
+  uint32_t n = _count++;
+  _wave[n & mask] = -ac;
+  _time[n & mask] = t;
+  if (! beat)
+    return false;
+
+  // Beats too long (e.g., detections missed) cannot be analyzed
+  bool complete = false;
+  if (_hasDetection && ((n-_lastDetection) < maxBeatSize)) {
+    // Foot of the current beat
+    uint32_t foot = _lastDetection+1;
+    for (uint32_t i=foot+1; i<=n; i++) {
+      if (_wave[i & mask] < _wave[foot & mask])
+        foot = i;
+    }
+    if (_hasFoot && ((n-_lastFoot) < maxBeatSize))
+      complete = _analyze(_lastFoot, foot, dc);
+    _lastFoot = foot;
+    _hasFoot = true;
+  } else {
+    _hasFoot = false;
+  }
+  _lastDetection = n;
+  _hasDetection = true;
+  return complete;
+}
+
+void
+Morphology::discard() {
+  _hasDetection = _hasFoot = false;
+}
+
+const BeatFeatures &
+Morphology::features() const {
+  return _features;
+}
+
+bool
+Morphology::_analyze(uint32_t begin, uint32_t end, Scalar dc) {
+  if ((end-begin) < 4)
+    return false;
+
+  // Systolic peak
+  uint32_t peak = begin;
+  for (uint32_t i=begin+1; i<end; i++) {
+    if (_wave[i & mask] > _wave[peak & mask])
+      peak = i;
+  }
+  Scalar foot = _wave[begin & mask];
+  Scalar amplitude = _wave[peak & mask] - foot;
+  if ((amplitude <= 0) || (dc <= 0))
+    return false;
+
+  _features.t = _time[begin & mask];
+  _features.interval  = (end-begin)*_period;
+  _features.perfusion = 100*amplitude/dc;
+  _features.riseTime  = (peak-begin)*_period;
+
+  // Second derivative, a wave is its maximum during the upstroke
+  Scalar d2[maxBeatSize];
+  for (uint32_t i=begin+1; i<end; i++)
+    d2[i-begin] = _wave[(i-1) & mask] - 2*_wave[i & mask] + _wave[(i+1) & mask];
+  uint32_t a = 1;
+  for (uint32_t i=2; (begin+i)<=peak && (begin+i)<end; i++) {
+    if (d2[i] > d2[a])
+      a = i;
+  }
+  _features.apg[0] = d2[a]/amplitude;
+  // b-e waves are the following alternating minima and maxima
+  int wave = 1;
+  for (uint32_t i=a+1; ((begin+i+1)<end) && (wave<5); i++) {
+    bool isMin = (d2[i] < d2[i-1]) && (d2[i] <= d2[i+1]);
+    bool isMax = (d2[i] > d2[i-1]) && (d2[i] >= d2[i+1]);
+    if ((wave & 1) ? isMin : isMax)
+      _features.apg[wave++] = (d2[a] != 0) ? d2[i]/d2[a] : NaN;
+  }
+  for (; wave<5; wave++)
+    _features.apg[wave] = NaN;
+
+  // Dicrotic notch, first local minimum of the wave after the peak
+  _features.notchTime = _features.notchHeight = NaN;
+  for (uint32_t i=peak+1; (i+1)<end; i++) {
+    Scalar v = _wave[i & mask];
+    if ((v < _wave[(i-1) & mask]) && (v <= _wave[(i+1) & mask])) {
+      _features.notchTime   = (i-begin)*_period;
+      _features.notchHeight = (v-foot)/amplitude;
+      break;
+    }
+  }
+
+  return true;
+}
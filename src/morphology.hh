@@ -0,0 +1,87 @@
+#ifndef MORPHOLOGY_HH
+#define MORPHOLOGY_HH
+
+#include "fir.hh"
+
+
+/** Features of a single beat, i.e., the pulse wave from one foot to the next. */
+struct BeatFeatures
+{
+  /** Time of the foot of the beat in minutes. */
+  double t;
+  /** Duration of the beat (foot to foot) in ms. */
+  float interval;
+  /** Perfusion index of the beat in percent (pulse amplitude over DC level). */
+  float perfusion;
+  /** Rise time (foot to systolic peak) in ms. */
+  float riseTime;
+  /** Time of the dicrotic notch after the foot in ms, NaN if not found. */
+  float notchTime;
+  /** Height of the dicrotic notch above the foot relative to the pulse amplitude, NaN if not
+   * found. */
+  float notchHeight;
+  /** Amplitudes of the a-e waves of the second derivative (acceleration plethysmogram). The a
+   * wave is given in pulse amplitudes per sample^2, the b-e waves relative to the a wave. NaN if
+   * not found. */
+  float apg[5];
+};
+
+
+/** Extracts the morphology features of the pulse wave beat by beat.
+ *
+ * Operates on the AC signal of the IR channel and the beats detected on it. The beats are
+ * detected on the systolic upstroke, the foot of a beat is the minimum of the pulse wave between
+ * two detections. Once the foot of the next beat is known, the complete beat gets analyzed. Only
+ * the last @c maxBeatSize samples are kept, hence the cost per sample is constant and the
+ * analysis of a beat is linear in its length. Note that the features are limited by the sample
+ * rate (e.g., 13.3Hz at a period of 75ms), in particular the APG waves get only coarsely
+ * resolved. */
+class Morphology
+{
+public:
+  /// Maximum length of a beat in samples, must be a power of 2.
+  const static uint16_t maxBeatSize = 128;
+  const static uint16_t mask = maxBeatSize-1;
+
+public:
+  /** Constructor.
+   * @param period Specifies the sample period in ms. */
+  Morphology(uint16_t period);
+
+  /** Resets the feature extractor. */
+  void reset();
+
+  /** Processes a sample of the @c dc and @c ac signal at time @c t (in minutes). @c beat
+   * specifies whether a beat was detected at this sample. Returns @c true if a beat got
+   * completed, its features are then available by @c features. */
+  bool update(double t, Scalar dc, Scalar ac, bool beat);
+  /** Discards the incomplete beat, e.g., if samples got skipped. */
+  void discard();
+
+  /** Returns the features of the last completed beat. */
+  const BeatFeatures &features() const;
+
+protected:
+  /** Analyzes the beat between the feet at the given sample indices. */
+  bool _analyze(uint32_t begin, uint32_t end, Scalar dc);
+
+protected:
+  /** Sample period in ms. */
+  uint16_t _period;
+  /** The last pulse wave samples (inverted AC signal). */
+  Scalar _wave[maxBeatSize];
+  /** Times of the last samples. */
+  double _time[maxBeatSize];
+  /** Number of samples processed. */
+  uint32_t _count;
+  /** Index of the sample of the last detection. */
+  uint32_t _lastDetection;
+  /** Index of the last foot. */
+  uint32_t _lastFoot;
+  bool _hasDetection;
+  bool _hasFoot;
+  /** Features of the last completed beat. */
+  BeatFeatures _features;
+};
+
+#endif // MORPHOLOGY_HH
@@ -0,0 +1,384 @@
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+#include "fir.hh"
+#include <vector>
+#include <cmath>
+
+
+/* A pipeline stage is any class implementing
+ *
+ *   bool apply(Scalar in, Scalar &out);
+ *   void reset();
+ *
+ * where @c apply processes a single input sample and returns @c true if an output sample has been
+ * stored in @c out (decimating stages produce fewer outputs than inputs). Stages get composed at
+ * compile time using @c Chain, @c Fork, @c Switch and @c MultiRate. As all stages are known to the
+ * compiler, the complete pipeline gets inlined into a single per-sample function without any
+ * dynamic dispatch or intermediate buffers. @c DynamicPipeline allows to compose stages at runtime
+ * for experiments. All stages process samples of the build-wide type @c Scalar (see fir.hh), hence a
+ * sample passes the complete pipeline without any conversions. */
+
+
+/** Adapts a filter providing @c Scalar @c apply(Scalar) (e.g., @c FIR) to the stage interface. */
+template <class F>
+class Filter: public F
+{
+public:
+  Filter(const F &filter)
+    : F(filter)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    out = F::apply(in);
+    return true;
+  }
+};
+
+
+/** Exponential moving average, @c theta specifies the update rate in 1/sample. */
+class EMA
+{
+public:
+  EMA(Scalar theta, Scalar init=0)
+    : _theta(theta), _init(init), _mean(init)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    _mean = (1-_theta)*_mean + _theta*in;
+    out = _mean;
+    return true;
+  }
+
+  void reset() {
+    _mean = _init;
+  }
+
+protected:
+  Scalar _theta;
+  Scalar _init;
+  Scalar _mean;
+};
+
+
+/** Absolute value. */
+class Abs
+{
+public:
+  inline bool apply(Scalar in, Scalar &out) {
+    out = std::abs(in);
+    return true;
+  }
+
+  void reset() { }
+};
+
+
+/** Passes the signal through and stores a copy at the given destination. Allows to access
+ * intermediate signals of a pipeline. */
+class Tee
+{
+public:
+  Tee(Scalar *dest)
+    : _dest(dest)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    *_dest = in;
+    out = in;
+    return true;
+  }
+
+  void reset() {
+    *_dest = 0;
+  }
+
+protected:
+  Scalar *_dest;
+};
+
+
+/** Ratio of two signals, the combine operation of a @c Fork. */
+class Ratio
+{
+public:
+  static inline Scalar eval(Scalar a, Scalar b) {
+    return a/b;
+  }
+};
+
+
+/** Pulse detector. Detects a pulse as a falling edge of the (AC) signal through half of its mean
+ * amplitude, followed by a crossing of the negative half of its mean amplitude. Outputs 1 on each
+ * detected pulse and 0 otherwise. */
+class Detector
+{
+public:
+  Detector(Scalar theta)
+    : _theta(theta)
+  {
+    reset();
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    bool wasAboveA = (_last > _amplitude/2);
+    bool wasAboveB = (_last > -_amplitude/2);
+    _amplitude = (1-_theta)*_amplitude + _theta*std::abs(in);
+    bool isBelowA = (in <= _amplitude/2);
+    bool isBelowB = (in <= -_amplitude/2);
+    _isFalling = (wasAboveA && isBelowA) || (_isFalling && ((_last-in) > 0));
+    out = (_isFalling && wasAboveB && isBelowB) ? 1 : 0;
+    _last = in;
+    return true;
+  }
+
+  void reset() {
+    _amplitude = _last = 0;
+    _isFalling = false;
+  }
+
+protected:
+  Scalar _theta;
+  Scalar _amplitude;
+  Scalar _last;
+  bool  _isFalling;
+};
+
+
+/** Serial composition of stages. */
+template <class ...Stages>
+class Chain;
+
+template <>
+class Chain<>
+{
+public:
+  inline bool apply(Scalar in, Scalar &out) {
+    out = in;
+    return true;
+  }
+
+  void reset() { }
+};
+
+template <class First, class ...Rest>
+class Chain<First, Rest...>
+{
+public:
+  Chain(const First &first, const Rest &...rest)
+    : _first(first), _rest(rest...)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    Scalar tmp;
+    if (! _first.apply(in, tmp))
+      return false;
+    return _rest.apply(tmp, out);
+  }
+
+  void reset() {
+    _first.reset();
+    _rest.reset();
+  }
+
+protected:
+  First _first;
+  Chain<Rest...> _rest;
+};
+
+
+/** Parallel composition of two stages, their outputs get combined with @c Op::eval(a,b). An
+ * output is produced only if both stages produce an output. */
+template <class A, class B, class Op>
+class Fork
+{
+public:
+  Fork(const A &a, const B &b)
+    : _a(a), _b(b)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    Scalar a, b;
+    bool hasA = _a.apply(in, a);
+    bool hasB = _b.apply(in, b);
+    if (! (hasA && hasB))
+      return false;
+    out = Op::eval(a, b);
+    return true;
+  }
+
+  void reset() {
+    _a.reset();
+    _b.reset();
+  }
+
+protected:
+  A _a;
+  B _b;
+};
+
+
+/** Selects one of the stages @c A and @c B at runtime by the flag @c *useB, which is owned by the
+ * caller (like the destination of @c Tee). Only the selected stage processes samples, hence a
+ * stage gets reset when it gets selected. The selection costs a single branch per sample. */
+template <class A, class B>
+class Switch
+{
+public:
+  Switch(const A &a, const B &b, const bool *useB)
+    : _a(a), _b(b), _useB(useB), _usingB(*useB)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    if (*_useB != _usingB) {
+      _usingB = *_useB;
+      if (_usingB)
+        _b.reset();
+      else
+        _a.reset();
+    }
+    return _usingB ? _b.apply(in, out) : _a.apply(in, out);
+  }
+
+  void reset() {
+    _a.reset();
+    _b.reset();
+    _usingB = *_useB;
+  }
+
+protected:
+  A _a;
+  B _b;
+  const bool *_useB;
+  bool _usingB;
+};
+
+
+/** Runs the @c Inner stage at a reduced rate, using the decimator @c Dec and the interpolator
+ * @c Interp. Produces one output sample per input sample. */
+template <class Dec, class Inner, class Interp>
+class MultiRate
+{
+public:
+  MultiRate(const Dec &dec, const Inner &inner, const Interp &interp)
+    : _dec(dec), _inner(inner), _interp(interp)
+  {
+    // pass...
+  }
+
+  inline bool apply(Scalar in, Scalar &out) {
+    Scalar low;
+    if (_dec.apply(in, low) && _inner.apply(low, low))
+      _interp.push(low);
+    out = _interp.apply();
+    return true;
+  }
+
+  void reset() {
+    _dec.reset();
+    _inner.reset();
+    _interp.reset();
+  }
+
+protected:
+  Dec _dec;
+  Inner _inner;
+  Interp _interp;
+};
+
+
+/** Processes a block of @c n samples with the given stage. Returns the number of output samples
+ * stored in @c out. */
+template <class Stage>
+inline size_t process(Stage &stage, const Scalar *in, Scalar *out, size_t n) {
+  size_t m = 0;
+  for (size_t i=0; i<n; i++) {
+    if (stage.apply(in[i], out[m]))
+      m++;
+  }
+  return m;
+}
+
+
+/** Interface of stages composed at runtime. */
+class AbstractStage
+{
+public:
+  virtual ~AbstractStage() { }
+  virtual bool apply(Scalar in, Scalar &out) = 0;
+  virtual void reset() = 0;
+};
+
+/** Wraps any stage into an @c AbstractStage. */
+template <class Stage>
+class DynamicStage: public AbstractStage, public Stage
+{
+public:
+  DynamicStage(const Stage &stage)
+    : AbstractStage(), Stage(stage)
+  {
+    // pass...
+  }
+
+  virtual bool apply(Scalar in, Scalar &out) {
+    return Stage::apply(in, out);
+  }
+
+  virtual void reset() {
+    Stage::reset();
+  }
+};
+
+/** Serial composition of stages at runtime, intended for experiments. */
+class DynamicPipeline
+{
+public:
+  DynamicPipeline() { }
+
+  ~DynamicPipeline() {
+    for (size_t i=0; i<_stages.size(); i++)
+      delete _stages[i];
+  }
+
+  /** Appends a copy of the given stage. */
+  template <class Stage>
+  void add(const Stage &stage) {
+    _stages.push_back(new DynamicStage<Stage>(stage));
+  }
+
+  bool apply(Scalar in, Scalar &out) {
+    for (size_t i=0; i<_stages.size(); i++) {
+      if (! _stages[i]->apply(in, in))
+        return false;
+    }
+    out = in;
+    return true;
+  }
+
+  void reset() {
+    for (size_t i=0; i<_stages.size(); i++)
+      _stages[i]->reset();
+  }
+
+private:
+  // Not copyable
+  DynamicPipeline(const DynamicPipeline &other);
+  DynamicPipeline &operator=(const DynamicPipeline &other);
+
+protected:
+  std::vector<AbstractStage *> _stages;
+};
+
+#endif // PIPELINE_HH
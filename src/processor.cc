@@ -0,0 +1,263 @@
+#include "processor.hh"
+#include <cmath>
+
+/// Time constant of the moving average filters in 1/sample (tau = 10s)
+#define THETA(period) (Scalar(period)/10e3)
+/// Lower cut-off frequency in 1/sample (== 15/min)
+#define Fmin(period)  (Scalar(period*15)/60e3)
+/// Upper cut-off frequency in 1/sample (== 180/min)
+#define Fmax(period)  (Scalar(period*180)/60e3)
+/// Cut-off frequency of the DC decimation and interpolation filters in 1/sample
+#define Fdc           (0.8*0.5/dcFactor)
+/// Length of the signal quality window in samples (== 3s)
+#define QUALITY_WINDOW(period) (3000/period)
+/// Process noise of the ratio trend in 1/min
+#define RATIO_Q 1e-2
+/// Measurement noise of the ratio per sample
+#define RATIO_R 2.5e-3
+/// Process noise of the pulse rate trend in BPM^2/min
+#define PULSE_Q 100.
+/// Measurement noise of the beat-to-beat pulse rate in BPM^2
+#define PULSE_R 25.
+/// Range of plausible beat-to-beat pulse rates in BPM
+#define PULSE_MIN 20.
+#define PULSE_MAX 300.
+/// Lag of the trend smoothers in samples (== 15s)
+#define SMOOTHER_LAG(period) (15000/period)
+
+
+static inline uint16_t gcd(uint16_t a, uint16_t b) {
+  while (b) {
+    uint16_t r = a%b;
+    a = b; b = r;
+  }
+  return a;
+}
+
+static inline uint16_t lcm(uint16_t a, uint16_t b) {
+  return (a/gcd(a,b))*b;
+}
+
+
+Processor::Processor(uint16_t period)
+  : _period(period), _medianDC(false),
+    _irPipeline(_channelPipeline(period, &_medianDC, &_irMean, &_irPulse, &_irStd)),
+    _redPipeline(_channelPipeline(period, &_medianDC, &_redMean, &_redPulse, &_redStd)),
+    _pulseDetector(THETA(period)), _ratioTracker(RATIO_Q, RATIO_R, SMOOTHER_LAG(period), 0, 1),
+    _pulseTracker(PULSE_Q, PULSE_R, SMOOTHER_LAG(period), 70, 400),
+    _morphology(period), _respiration(period), _quality(QUALITY_WINDOW(period))
+{
+  reset();
+}
+
+Processor::ChannelPipeline
+Processor::_channelPipeline(uint16_t period, const bool *median, Scalar *dc, Scalar *ac,
+                            Scalar *std)
+{
+  return ChannelPipeline(
+        ACPipeline(FIR< BandPassKernel<firSize> >(BandPassKernel<firSize>(2*Fmin(period), Fmax(period))),
+                   Tee(ac), Abs(), EMA(THETA(period)), Tee(std)),
+        Chain<DCPipeline, Tee>(_dcPipeline(period, median), Tee(dc)));
+}
+
+Processor::DCPipeline
+Processor::_dcPipeline(uint16_t period, const bool *median) {
+  return DCPipeline(
+        SincDCPipeline(
+          LowPassKernel<dcRateFirSize>(Fdc),
+          FIR< LowPassKernel<dcFirSize> >(LowPassKernel<dcFirSize>(dcFactor*Fmin(period))),
+          LowPassKernel<dcRateFirSize>(Fdc)),
+        MedianDCPipeline(RunningMedian<firSize>()),
+        median);
+}
+
+void
+Processor::reset() {
+  _t = 0;
+  _ir = _red = 0;
+  _irPipeline.reset();
+  _redPipeline.reset();
+  _pulseDetector.reset();
+  _ratioTracker.reset(0, 1);
+  _lastPulse = 0;
+  _pulse = 70;
+  _pulseTracker.reset(70, 400);
+  _morphology.reset();
+  _hasBeatFeatures = false;
+  _respiration.reset();
+  _quality.reset();
+}
+
+bool
+Processor::update(double t, double base, double ir, double red) {
+  // check raw intensities for clipping
+  _quality.addRaw(base, ir, red);
+  // adjust ir & red with base
+  return update(t, ir-base, red-base);
+}
+
+bool
+Processor::update(double t, double ir, double red) {
+  double dt = std::max(0., t-_t);
+  _t   = t;
+  _ir  = ir;
+  _red = red;
+
+  Scalar irPerfusion, redPerfusion, beat;
+  _irPipeline.apply(_ir, irPerfusion);
+  _redPipeline.apply(_red, redPerfusion);
+  _pulseDetector.apply(_irPulse, beat);
+
+  _quality.addSample(_irMean, _irPulse, _irStd, _redPulse);
+  bool valid = _quality.isValid();
+
+  // The features of garbage beats are meaningless, skip their extraction
+  _hasBeatFeatures = false;
+  if (valid)
+    _hasBeatFeatures = _morphology.update(_t, _irMean, _irPulse, beat > 0);
+  else
+    _morphology.discard();
+  _respiration.update(_t, _irMean, _irPulse);
+
+  // Update trends, only predict them if the signal is garbage
+  _ratioTracker.predict(dt);
+  _pulseTracker.predict(dt);
+  if (valid)
+    _ratioTracker.update(redPerfusion/irPerfusion, _quality.index());
+
+  if (beat > 0) {
+    double f = 1./(_t - _lastPulse);
+    _quality.addBeat(f, _pulse);
+    _pulse = f;
+    _lastPulse = _t;
+    if (valid && (f >= PULSE_MIN) && (f <= PULSE_MAX))
+      _pulseTracker.update(f, _quality.index());
+  }
+
+  return beat > 0;
+}
+
+bool
+Processor::medianDC() const {
+  return _medianDC;
+}
+
+void
+Processor::setMedianDC(bool enabled) {
+  _medianDC = enabled;
+}
+
+uint16_t
+Processor::period() const {
+  return _period;
+}
+
+uint16_t
+Processor::alignment() const {
+  return lcm(lcm(QUALITY_WINDOW(_period), dcFactor), Respiration::factor);
+}
+
+double
+Processor::t() const {
+  return _t;
+}
+
+double
+Processor::ir() const {
+  return _ir;
+}
+
+double
+Processor::irMean() const {
+  return _irMean;
+}
+
+double
+Processor::irPulse() const {
+  return _irPulse;
+}
+
+double
+Processor::irStd() const {
+  return _irStd;
+}
+
+double
+Processor::red() const {
+  return _red;
+}
+
+double
+Processor::redMean() const {
+  return _redMean;
+}
+
+double
+Processor::redPulse() const {
+  return _redPulse;
+}
+
+double
+Processor::redStd() const {
+  return _redStd;
+}
+
+double
+Processor::ratio() const {
+  return _ratioTracker.value();
+}
+
+double
+Processor::ratioStd() const {
+  return _ratioTracker.stdDev();
+}
+
+double
+Processor::pulse() const {
+  return _pulseTracker.value();
+}
+
+double
+Processor::pulseStd() const {
+  return _pulseTracker.stdDev();
+}
+
+const TrendTracker &
+Processor::ratioTracker() const {
+  return _ratioTracker;
+}
+
+const TrendTracker &
+Processor::pulseTracker() const {
+  return _pulseTracker;
+}
+
+double
+Processor::perfusionIndex() const {
+  return (_irMean > 0) ? 100*_irStd/_irMean : 0;
+}
+
+bool
+Processor::hasBeatFeatures() const {
+  return _hasBeatFeatures;
+}
+
+const BeatFeatures &
+Processor::beatFeatures() const {
+  return _morphology.features();
+}
+
+double
+Processor::respirationRate() const {
+  return _respiration.rate();
+}
+
+double
+Processor::quality() const {
+  return _quality.index();
+}
+
+bool
+Processor::isValid() const {
+  return _quality.isValid();
+}
@@ -0,0 +1,176 @@
+#ifndef PROCESSOR_HH
+#define PROCESSOR_HH
+
+#include "pipeline.hh"
+#include "median.hh"
+#include "quality.hh"
+#include "respiration.hh"
+#include "tracker.hh"
+#include "morphology.hh"
+
+
+/** Implements the signal processing of the pulse oximeter, independent of the device.
+ *
+ * Derives the DC and AC components of the IR and RED channels, the ratio of ratios, the pulse rate,
+ * the respiratory rate, the signal quality and the per-beat pulse wave morphology from the raw
+ * (normalized) intensities. The
+ * processing is deterministic, i.e., feeding the same samples yields the same results. Hence it is
+ * used for the live measurement as well as for the offline analysis of recordings. */
+class Processor
+{
+public:
+  /// Convolution filter kernel size in samples
+  const static uint16_t firSize = 128;
+  /// Decimation factor of the DC (baseline) filters
+  const static uint16_t dcFactor = 4;
+  /// Kernel size of the DC decimation and interpolation filters in samples
+  const static uint16_t dcRateFirSize = 32;
+  /// Kernel size of the DC filters in decimated samples
+  const static uint16_t dcFirSize = firSize/dcFactor;
+
+  /** Sinc low-pass DC path, the DC filter runs at the reduced rate. */
+  typedef MultiRate< Decimator< LowPassKernel<dcRateFirSize>, dcFactor >,
+                     Filter< FIR< LowPassKernel<dcFirSize> > >,
+                     Interpolator< LowPassKernel<dcRateFirSize>, dcFactor > > SincDCPipeline;
+  /** Running median DC path, which is robust against spikes and motion artifacts. It runs at the
+   * full rate over the same time span as the sinc low-pass, as the decimation filter would
+   * smear any spike over its kernel before the median could reject it. */
+  typedef Filter< RunningMedian<firSize> > MedianDCPipeline;
+  /** DC path, selected at runtime (see @c setMedianDC). */
+  typedef Switch<SincDCPipeline, MedianDCPipeline> DCPipeline;
+  /** AC path, band-pass filter followed by its mean amplitude. */
+  typedef Chain< Filter< FIR< BandPassKernel<firSize> > >, Tee, Abs, EMA, Tee > ACPipeline;
+  /** Processing of a single channel, outputs the perfusion (AC amplitude over DC level). */
+  typedef Fork< ACPipeline, Chain<DCPipeline, Tee>, Ratio > ChannelPipeline;
+
+public:
+  /** Constructor.
+   * @param period Specifies the sample period in ms. */
+  Processor(uint16_t period);
+
+  /** Resets the processing state. */
+  void reset();
+
+  /** Processes the raw intensities @c base, @c ir and @c red (normalized to [0,1]) measured at
+   * time @c t (in minutes). Returns @c true if a heartbeat was detected. */
+  bool update(double t, double base, double ir, double red);
+  /** Processes the @c ir and @c red intensities with the base already subtracted. As the raw
+   * intensities are unknown, no clipping detection is performed. Returns @c true if a heartbeat
+   * was detected. */
+  bool update(double t, double ir, double red);
+
+  /** Returns @c true if the DC components get extracted by running median filters. */
+  bool medianDC() const;
+  /** Selects the running median (if @c enabled) or the sinc low-pass DC filters. The newly
+   * selected filters start from scratch, hence the DC levels need to settle again. */
+  void setMedianDC(bool enabled);
+
+  /** Returns the sample period in ms. */
+  uint16_t period() const;
+  /** Returns the number of samples, the processing state is periodic in (e.g., due to decimation
+   * and quality windows). Processing of a recording must start at a multiple of it to reproduce
+   * the results of a sequential run. */
+  uint16_t alignment() const;
+
+  /** Returns the time (in minutes) of the last sample. */
+  double t() const;
+  /** Returns the current IR intensity level. */
+  double ir() const;
+  /** Returns the current mean IR intensity level (DC component). */
+  double irMean() const;
+  /** Returns the current IR intensity deviation from the mean level (AC component). */
+  double irPulse() const;
+  /** Returns the current amplitude if the IR intensity deviation (AC component). */
+  double irStd() const;
+  /** Returns the current RED intensity level. */
+  double red() const;
+  /** Returns the current mean RED intensity level (DC component). */
+  double redMean() const;
+  /** Returns the current RED intensity deviation from the mean level (AC component). */
+  double redPulse() const;
+  /** Returns the current amplitude if the RED intensity deviation (AC component). */
+  double redStd() const;
+  /** Returns the current trend of the ratio of the RED and IR perfusion (ratio of ratios). */
+  double ratio() const;
+  /** Returns the standard deviation of the ratio trend. */
+  double ratioStd() const;
+  /** Returns the current estimate of the pulse rate in BPM. */
+  double pulse() const;
+  /** Returns the standard deviation of the pulse rate estimate in BPM. */
+  double pulseStd() const;
+  /** Returns the tracker of the ratio trend (e.g., to obtain the smoothed trend). */
+  const TrendTracker &ratioTracker() const;
+  /** Returns the tracker of the pulse rate trend (e.g., to obtain the smoothed trend). */
+  const TrendTracker &pulseTracker() const;
+  /** Returns the current perfusion index (IR AC amplitude over DC level) in percent. */
+  double perfusionIndex() const;
+  /** Returns @c true if the last sample completed a beat, its features are then available by
+   * @c beatFeatures. */
+  bool hasBeatFeatures() const;
+  /** Returns the morphology features of the last completed beat. */
+  const BeatFeatures &beatFeatures() const;
+  /** Returns the current estimate of the respiratory rate in breaths per minute. */
+  double respirationRate() const;
+  /** Returns the current signal quality index in [0,1]. */
+  double quality() const;
+  /** Returns @c true if the signal quality is sufficient to trust the SpO2 and pulse estimates. */
+  bool isValid() const;
+
+protected:
+  /** Assembles the processing pipeline of a channel, storing the DC, AC and AC amplitude signals
+   * in the given destinations. */
+  static ChannelPipeline _channelPipeline(uint16_t period, const bool *median, Scalar *dc,
+                                          Scalar *ac, Scalar *std);
+  /** Assembles the DC path of a channel, selected by @c *median. */
+  static DCPipeline _dcPipeline(uint16_t period, const bool *median);
+
+private:
+  // Not copyable, the pipelines refer to the members.
+  Processor(const Processor &other);
+  Processor &operator=(const Processor &other);
+
+protected:
+  /** Sample period in ms. */
+  uint16_t _period;
+  /** If @c true, the DC components get extracted by running median filters. */
+  bool _medianDC;
+
+  double _t;
+  /** Signals of the IR and RED channels (in the sample type of the processing). */
+  Scalar _ir;
+  Scalar _irMean;
+  Scalar _irPulse;
+  Scalar _irStd;
+  Scalar _red;
+  Scalar _redMean;
+  Scalar _redPulse;
+  Scalar _redStd;
+
+  /** Processing pipeline of the IR channel. */
+  ChannelPipeline _irPipeline;
+  /** Processing pipeline of the RED channel. */
+  ChannelPipeline _redPipeline;
+  /** Pulse detector operating on the IR AC signal. */
+  Detector _pulseDetector;
+
+  /** Tracks the ratio of ratios. */
+  TrendTracker _ratioTracker;
+
+  double _lastPulse;
+  /** Beat-to-beat pulse rate. */
+  double _pulse;
+  /** Tracks the pulse rate. */
+  TrendTracker _pulseTracker;
+
+  /** Pulse wave morphology. */
+  Morphology _morphology;
+  /** If @c true, the last sample completed a beat. */
+  bool _hasBeatFeatures;
+
+  /** Respiratory rate estimator. */
+  Respiration _respiration;
+  /** Signal quality estimator. */
+  SignalQuality _quality;
+};
+
+#endif // PROCESSOR_HH
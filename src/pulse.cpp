@@ -1,24 +1,20 @@
 #include "pulse.h"
 #include <qDebug>
 #include <cmath>
+#include <algorithm>
 #include <QtEndian>
+#include <QFileInfo>
+#include <QDir>
+#include "rederive.hh"
 
 #include "../firmware/proto.h"      /* custom request numbers */
 #include "../firmware/usbconfig.h"  /* device's VID/PID and names */
 
-/// Time constant of the moving average filters in 1/sample (tau = 10s)
-#define THETA (float(PERIOD)/10e3)
-/// Lower cut-off frequency in 1/sample (== 15/min)
-#define Fmin  (float(PERIOD*15)/60e3)
-/// Upper cut-off frequency in 1/sample (== 180/min)
-#define Fmax  (float(PERIOD*180)/60e3)
-
-
 
 Pulse::Pulse(bool swapChannels, QObject *parent)
-  : QObject(parent), _usbctx(0), _device(0), _irDCFilter(LowPassKernel<firSize>(Fmin)),
-    _irACFilter(BandPassKernel<firSize>(2*Fmin, Fmax)), _redDCFilter(LowPassKernel<firSize>(Fmin)),
-    _redACFilter(BandPassKernel<firSize>(2*Fmin, Fmax)), _swapChannels(swapChannels)
+  : QObject(parent), _usbctx(0), _device(0), _rawBase(0), _rawIr(0), _rawRed(0),
+    _processor(PERIOD), _edf(PERIOD, 3000/PERIOD), _logSyncPolicy(AsyncWriter::SYNC_NEVER),
+    _logSyncInterval(0), _logDroppedBefore(0), _swapChannels(swapChannels)
 {
   _timer.setInterval(PERIOD);
   _timer.setSingleShot(false);
@@ -56,67 +52,99 @@ Pulse::isConnected() const {
 
 double
 Pulse::t() const {
-  return _t;
+  return _processor.t();
 }
 
 double
 Pulse::ir() const {
-  return _ir;
+  return _processor.ir();
 }
 
 double
 Pulse::irMean() const {
-  return _irMean;
+  return _processor.irMean();
 }
 
 double
 Pulse::irPulse() const {
-  return _irPulse;
+  return _processor.irPulse();
 }
 
 double
 Pulse::irStd() const {
-  return _irStd;
+  return _processor.irStd();
 }
 
 double
 Pulse::red() const {
-  return _red;
+  return _processor.red();
 }
 
 double
 Pulse::redMean() const {
-  return _redMean;
+  return _processor.redMean();
 }
 
 double
 Pulse::redPulse() const {
-  return _redPulse;
+  return _processor.redPulse();
 }
 
 double
 Pulse::redStd() const {
-  return _redStd;
+  return _processor.redStd();
+}
+
+double
+Pulse::ratio() const {
+  return _processor.ratio();
 }
 
 double
 Pulse::SpO2() const {
-  return _SpO2;
+  return _curve.eval(_processor.ratio());
+}
+
+double
+Pulse::SpO2Std() const {
+  // propagate the ratio uncertainty through the calibration curve
+  double r = _processor.ratio(), s = _processor.ratioStd();
+  return std::abs(_curve.eval(r-s) - _curve.eval(r+s))/2;
 }
 
 double
 Pulse::pulse() const {
-  return _pulseMean;
+  return _processor.pulse();
+}
+
+double
+Pulse::pulseStd() const {
+  return _processor.pulseStd();
+}
+
+double
+Pulse::perfusionIndex() const {
+  return _processor.perfusionIndex();
+}
+
+double
+Pulse::respirationRate() const {
+  return _processor.respirationRate();
+}
+
+double
+Pulse::quality() const {
+  return _processor.quality();
+}
+
+bool
+Pulse::isValid() const {
+  return _processor.isValid();
 }
 
 void
 Pulse::start() {
-  _t=0;
-  _irMean = _redMean = 0;
-  _irPulse = _redPulse = 0;
-  _irStd = _redStd = 0;
-
-  _pulseMean = 70;
+  _processor.reset();
 
   _startTime = QDateTime::currentDateTime();
   _timer.start();
@@ -164,9 +192,12 @@ Pulse::readMeasurement(double &base, double &ir, double &red) {
   if (_swapChannels)
     std::swap(msg.upper, msg.lower);
 
-  base = (0xffff-double(qFromLittleEndian(msg.base)))/0xffff;
-  ir   = (0xffff-double(qFromLittleEndian(msg.upper)))/0xffff;
-  red  = (0xffff-double(qFromLittleEndian(msg.lower)))/0xffff;
+  _rawBase = qFromLittleEndian(msg.base);
+  _rawIr   = qFromLittleEndian(msg.upper);
+  _rawRed  = qFromLittleEndian(msg.lower);
+  base = (0xffff-double(_rawBase))/0xffff;
+  ir   = (0xffff-double(_rawIr))/0xffff;
+  red  = (0xffff-double(_rawRed))/0xffff;
   return true;
 }
 
@@ -174,48 +205,28 @@ void
 Pulse::updateMeasurement() {
   if (readMeasurement(_base, _ir, _red)) {
     // Get time point
-    _t = _startTime.msecsTo(QDateTime::currentDateTime());
-    _t /= 60e3;
-    // adjust _ir & _red with base
-    _ir -= _base;
-    _red -= _base;
-
-    // Detect pulse (last value was positive)
-    double lastIrPulse = _irPulse;
-    bool wasAboveA = (_irPulse > _irStd/2);
-    bool wasAboveB = (_irPulse > -_irStd/2);
-
-    _irMean = _irDCFilter.apply(_ir);
-    _irPulse = _irACFilter.apply(_ir);
-    _irStd   = (1.-THETA)*_irStd + THETA*std::abs(_irPulse);
-
-    _redMean = _redDCFilter.apply(_red);
-    _redPulse = _redACFilter.apply(_red);
-    _redStd   = (1.-THETA)*_redStd + THETA*std::abs(_redPulse);
-
-    // Taken from NXP AN4327
-    double r = (_redStd*_irMean)/(_irStd*_redMean);
-    if (r < 1)
-      _SpO2 = -25*r + 110;
-    else
-      _SpO2 = -35.4167*r + 120.4167;
-
-    // If last pulse was positive and current negative -> pulse event
-    bool isBelowA = (_irPulse <= _irStd/2);
-    bool isBelowB = (_irPulse <= -_irStd/2);
-    bool isFalling = ((lastIrPulse - _irPulse)>0);
-    _isFalling = (wasAboveA && isBelowA) || (_isFalling && isFalling);
-    bool isPulse = _isFalling && wasAboveB && isBelowB;
-    double f = 1./(_t - _lastPulse);
-    if (isPulse) {
-      _pulse = f;
-      _lastPulse = _t;
+    double t = _startTime.msecsTo(QDateTime::currentDateTime());
+    t /= 60e3;
+
+    bool isPulse = _processor.update(t, _base, _ir, _red);
+    bool valid = _processor.isValid();
+    if (isPulse && valid)
       emit pulseEvent();
-    }
-    _pulseMean = (1.-THETA)*_pulseMean + THETA*_pulse;
 
-    if (_logFile.isOpen())
+    // Do not log garbage
+    if (valid && _logFile.isOpen())
       _logValues();
+    // Binary logs keep all samples, flagged by their validity
+    if (_binaryLog.isOpen() || _columnar.isOpen() || _edf.isOpen() || _pyramid.isOpen())
+      _logRecord(isPulse);
+    // Raw logs keep the raw samples only, the values get re-derived on demand
+    if (_rawLog.isOpen())
+      _rawLog.write(uint32_t(t*60e3 + 0.5), _rawBase, _rawIr, _rawRed);
+    if (valid && _processor.hasBeatFeatures() && _beatFile.isOpen())
+      _logBeat();
+    // Continuous recordings get split into segments
+    if (_segments.isSegmented() && _segments.due(QDateTime::currentMSecsSinceEpoch(), _logSize()))
+      _rotateLog();
 
     emit measurement();
   }
@@ -253,24 +264,164 @@ Pulse::reconnect() {
     return false;
   }
 
+  // Get serial number (if any) to select the calibration curve
+  _serial.clear();
+  libusb_device_descriptor descr;
+  if ((0 == libusb_get_device_descriptor(libusb_get_device(_device), &descr)) && descr.iSerialNumber) {
+    unsigned char serial[64];
+    int len = libusb_get_string_descriptor_ascii(_device, descr.iSerialNumber, serial, sizeof(serial));
+    if (0 < len)
+      _serial = QString::fromLatin1((const char *)serial, len);
+  }
+  _curve = _calibration.curve(_serial);
+
+  return true;
+}
+
+const QString &
+Pulse::serial() const {
+  return _serial;
+}
+
+bool
+Pulse::loadCalibration(const QString &filename) {
+  if (filename.isEmpty())
+    _calibration.reset();
+  else if (! _calibration.load(filename))
+    return false;
+  _curve = _calibration.curve(_serial);
   return true;
 }
 
+const Calibration &
+Pulse::calibration() const {
+  return _calibration;
+}
+
 
 bool
 Pulse::logTo(const QString &filename) {
-  if (_logFile.isOpen())
-    closeLog();
-  _logFile.setFileName(filename);
-  if (_logFile.open(QIODevice::WriteOnly)) {
-    _logFile.write("#PULSE\tSpO2\tIR_RAW\tIR_DC\tIR_AC\tIR_STD\tRED_RAW\tRED_DC\tRED_AC\tRED_STD\n");
-  }
+  closeLog();
+  _logDroppedBefore = 0;
+  if (_openLog(_segments.begin(filename, QDateTime::currentMSecsSinceEpoch())))
+    return true;
+  closeLog();
   return false;
 }
 
 void
 Pulse::closeLog() {
+  _closeLog();
+  _segments.finish(QDateTime::currentMSecsSinceEpoch());
+}
+
+void
+Pulse::setLogRotation(quint64 maxSize, int64_t maxDuration) {
+  _segments.setRotation(maxSize, maxDuration);
+}
+
+void
+Pulse::setLogRetention(quint64 maxTotalSize, int64_t maxAge) {
+  _segments.setRetention(maxTotalSize, maxAge);
+}
+
+void
+Pulse::setLogSyncPolicy(AsyncWriter::SyncPolicy policy, unsigned long interval) {
+  _logSyncPolicy = policy;
+  _logSyncInterval = interval;
+}
+
+void
+Pulse::setLogFormat(char delimiter, int precision) {
+  _row.setDelimiter(delimiter);
+  _row.setPrecision(precision);
+  _beatRow.setPrecision(precision);
+}
+
+quint64
+Pulse::logDropped() const {
+  // Drops of the closed segments plus those of the open files
+  quint64 dropped = _logDroppedBefore;
+  const AsyncWriter *writers[] = { &_logFile, &_binaryLog.writer(), &_columnar.writer(),
+                                   &_rawLog.writer(), &_edf.writer(), &_beatFile };
+  for (size_t i=0; i<(sizeof(writers)/sizeof(writers[0])); i++) {
+    if (writers[i]->isOpen())
+      dropped += writers[i]->dropped();
+  }
+  if (_pyramid.isOpen())
+    dropped += _pyramid.dropped();
+  return dropped;
+}
+
+bool
+Pulse::_openLog(const QString &filename) {
+  QFileInfo info(filename);
+  if (0 == info.suffix().compare("plog", Qt::CaseInsensitive)) {
+    _binaryLog.writer().setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+    if (! _binaryLog.open(filename, PERIOD, _startTime.toMSecsSinceEpoch(), _serial))
+      return false;
+  } else if (0 == info.suffix().compare("pcol", Qt::CaseInsensitive)) {
+    _columnar.writer().setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+    if (! _columnar.open(filename, PERIOD, _startTime.toMSecsSinceEpoch(), _serial))
+      return false;
+  } else if (0 == info.suffix().compare("praw", Qt::CaseInsensitive)) {
+    _rawLog.writer().setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+    if (! _rawLog.open(filename, PERIOD, _startTime.toMSecsSinceEpoch(), _serial))
+      return false;
+  } else if (0 == info.suffix().compare("edf", Qt::CaseInsensitive)) {
+    _edf.writer().setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+    if (! _edf.open(filename, _startTime, _serial))
+      return false;
+  } else {
+    _logFile.setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+    if (! _logFile.open(filename))
+      return false;
+    _logFile.write(QByteArray("#PULSE\tSpO2\tIR_RAW\tIR_DC\tIR_AC\tIR_STD\tRED_RAW\tRED_DC\tRED_AC"
+                              "\tRED_STD\tRATIO\tT\n").replace('\t', _row.delimiter()));
+  }
+  if (_binaryLog.isOpen() || _columnar.isOpen() || _rawLog.isOpen()) {
+    // The pyramid is optional, the recording works without it
+    _pyramid.setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+    if (! _pyramid.open(filename, _startTime.toMSecsSinceEpoch()))
+      qDebug() << "Cannot create the pyramid of" << filename;
+  }
+  _beatFile.setSyncPolicy(_logSyncPolicy, _logSyncInterval);
+  if (_beatFile.open(info.dir().filePath(info.completeBaseName() + ".beats.tsv"))) {
+    _beatFile.write("#T\tINTERVAL\tPI\tRISE\tNOTCH_T\tNOTCH_H\tAPG_A\tAPG_B\tAPG_C\tAPG_D\tAPG_E\n");
+  }
+  return true;
+}
+
+void
+Pulse::_closeLog() {
+  _logDroppedBefore = logDropped();
   _logFile.close();
+  _binaryLog.close();
+  _columnar.close();
+  _rawLog.close();
+  _edf.close();
+  _pyramid.close();
+  _beatFile.close();
+}
+
+void
+Pulse::_rotateLog() {
+  // The next segment continues the time line of the recording
+  _closeLog();
+  if (! _openLog(_segments.rotate(QDateTime::currentMSecsSinceEpoch())))
+    qDebug() << "Cannot open the next segment" << _segments.current();
+}
+
+quint64
+Pulse::_logSize() const {
+  const AsyncWriter *writers[] = { &_logFile, &_binaryLog.writer(), &_columnar.writer(),
+                                   &_rawLog.writer(), &_edf.writer() };
+  quint64 size = 0;
+  for (size_t i=0; i<(sizeof(writers)/sizeof(writers[0])); i++) {
+    if (writers[i]->isOpen())
+      size += writers[i]->written();
+  }
+  return size;
 }
 
 void
@@ -278,19 +429,52 @@ Pulse::_logValues() {
   if (! _logFile.isOpen())
     return;
 
-  _logFile.write(QString::number(_pulseMean).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_SpO2).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_ir).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_irMean).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_irPulse).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_irStd).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_red).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_redMean).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_redPulse).toUtf8()); _logFile.write("\t");
-  _logFile.write(QString::number(_redStd).toUtf8()); _logFile.write("\n");
+  // Assemble the row and hand it over to the writer at once, a row is either logged or dropped
+  _row.clear();
+  _row.add(pulse()); _row.add(SpO2());
+  _row.add(ir()); _row.add(irMean()); _row.add(irPulse()); _row.add(irStd());
+  _row.add(red()); _row.add(redMean()); _row.add(redPulse()); _row.add(redStd());
+  _row.add(ratio()); _row.add(t());
+  _row.end();
+  _logFile.write(_row.line());
+}
+
+void
+Pulse::_logRecord(bool beat) {
+  BinaryLogRecord record;
+  record.t       = uint32_t(t()*60e3 + 0.5);
+  record.base    = _rawBase;
+  record.ir      = _rawIr;
+  record.red     = _rawRed;
+  deriveRecord(_processor, _curve, beat, record);
+  if (_binaryLog.isOpen())
+    _binaryLog.write(record);
+  if (_columnar.isOpen())
+    _columnar.write(record);
+  if (_edf.isOpen())
+    _edf.write(record);
+  if (_pyramid.isOpen())
+    _pyramid.add(record);
+}
+
+void
+Pulse::_logBeat() {
+  const BeatFeatures &beat = _processor.beatFeatures();
+  _beatRow.clear();
+  _beatRow.add(beat.t); _beatRow.add(beat.interval); _beatRow.add(beat.perfusion);
+  _beatRow.add(beat.riseTime); _beatRow.add(beat.notchTime); _beatRow.add(beat.notchHeight);
+  for (int i=0; i<5; i++)
+    _beatRow.add(beat.apg[i]);
+  _beatRow.end();
+  _beatFile.write(_beatRow.line());
 }
 
 void
 Pulse::setSwapChannels(bool swap) {
   _swapChannels = swap;
 }
+
+void
+Pulse::setMedianDC(bool enabled) {
+  _processor.setMedianDC(enabled);
+}
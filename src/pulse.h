@@ -6,7 +6,15 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QFile>
-#include "fir.hh"
+#include "processor.hh"
+#include "calibration.hh"
+#include "binarylog.hh"
+#include "columnar.hh"
+#include "rawlog.hh"
+#include "edf.hh"
+#include "pyramid.hh"
+#include "textrow.hh"
+#include "segments.hh"
 
 
 /** Implements the communication with the device. */
@@ -16,9 +24,6 @@ class Pulse : public QObject
 public:
   /// Update period in ms
   const static uint16_t PERIOD  = 75;
-  /// Convolution filter kernel size in samples
-  const static uint16_t firSize = 128;
-
 public:
   /** Constructs a Pulse instance and tries to connect to the pulse oximeter hardware. */
   explicit Pulse(bool swapChannels=false, QObject *parent = 0);
@@ -52,25 +57,70 @@ public:
   double redPulse() const;
   /** Returns the current amplitude if the RED intensity deviation (AC component). */
   double redStd() const;
-  /** Returns the current estimate of the SpO2 level in percent. */
+  /** Returns the current trend of the ratio of the RED and IR perfusion (ratio of ratios). */
+  double ratio() const;
+  /** Returns the current estimate of the SpO2 level in percent. The calibration curve of the
+   * connected device is applied to the current ratio on every call. */
   double SpO2() const;
+  /** Returns the standard deviation of the SpO2 estimate in percent. */
+  double SpO2Std() const;
   /** Returns the current estimate of the pulse rate in BPM. */
   double pulse() const;
-
-  /** Starts data logging to the given filename. */
+  /** Returns the standard deviation of the pulse rate estimate in BPM. */
+  double pulseStd() const;
+  /** Returns the current perfusion index in percent. */
+  double perfusionIndex() const;
+  /** Returns the current estimate of the respiratory rate in breaths per minute. */
+  double respirationRate() const;
+  /** Returns the current signal quality index in [0,1]. */
+  double quality() const;
+  /** Returns @c true if the signal quality is sufficient to trust the SpO2 and pulse estimates. */
+  bool isValid() const;
+
+  /** Starts data logging to the given filename. If the filename has the extension .plog, a
+   * binary log (see @c BinaryLogWriter) is written, if it has the extension .pcol a compressed
+   * columnar recording (see @c ColumnarWriter), if it has the extension .praw a raw log (see
+   * @c RawLogWriter) holding the raw samples only, if it has the extension .edf an EDF+ file (see
+   * @c EDFWriter), otherwise a text log. The features of each
+   * beat get logged into a separate file next to it (with the extension .beats.tsv). If a
+   * rotation is set, the log gets split into segments (see @c SegmentedRecording). Returns
+   * @c false on error. */
   bool logTo(const QString &filename);
   /** Stops data logging. */
   void closeLog();
+  /** Sets the maximum size (in bytes) and duration (in ms) of the log segments, 0 disables the
+   * respective limit. Applies to logs opened afterwards. */
+  void setLogRotation(quint64 maxSize, int64_t maxDuration);
+  /** Sets the maximum total size (in bytes) and age (in ms) of the log segments kept. */
+  void setLogRetention(quint64 maxTotalSize, int64_t maxAge);
+  /** Sets the sync policy of the logs, applies to logs opened afterwards. @c interval specifies
+   * the sync interval in ms for @c AsyncWriter::SYNC_PERIODIC. */
+  void setLogSyncPolicy(AsyncWriter::SyncPolicy policy, unsigned long interval=0);
+  /** Sets the field delimiter and the number of significant digits (0 for the shortest
+   * round-trip representation) of text logs. */
+  void setLogFormat(char delimiter, int precision=0);
+  /** Returns the number of log rows and records dropped, since the disk was too slow. */
+  quint64 logDropped() const;
+
+  /** Returns the serial number of the connected device (empty if the device has none). */
+  const QString &serial() const;
+  /** Loads the calibration curves from the given file. An empty filename resets the calibration
+   * to the default curve. */
+  bool loadCalibration(const QString &filename);
+  /** Returns the calibration curves for all known devices. */
+  const Calibration &calibration() const;
 
   /** (Re-)Sets if IR and RED channels are swaped. */
   void setSwapChannels(bool swap);
+  /** Selects the running median or the sinc low-pass DC filters (see @c Processor). */
+  void setMedianDC(bool enabled);
 
 signals:
   /** Gets emitted if the connection to the pulse oximeter is lost. */
   void connectionLost();
   /** Gets emitted if a measurement is complete. */
   void measurement();
-  /** Gets emitted on every detected heartbeat. */
+  /** Gets emitted on every detected heartbeat (if the signal is valid). */
   void pulseEvent();
 
 protected slots:
@@ -84,6 +134,19 @@ protected slots:
 protected:
   /** Saves the current measurements and estimates to the log file (if one is set). */
   void _logValues();
+  /** Saves the features of the last beat to the beat log file (if one is set). */
+  void _logBeat();
+  /** Saves the current raw sample and estimates to the binary log, columnar recording or EDF+
+   * file. */
+  void _logRecord(bool beat);
+  /** Opens the logs to the given file (or segment). Returns @c false on error. */
+  bool _openLog(const QString &filename);
+  /** Closes all logs. */
+  void _closeLog();
+  /** Closes the current segment of the log and continues with the next one. */
+  void _rotateLog();
+  /** Returns the number of bytes written to the current log file. */
+  quint64 _logSize() const;
 
 protected:
   /** The USB context. */
@@ -98,30 +161,44 @@ protected:
   /** Start time. */
   QDateTime _startTime;
 
-  double _t;
+  /** The last raw sample. */
   double _base;
   double _ir;
-  double _irMean;
-  double _irPulse;
-  double _irStd;
   double _red;
-  double _redMean;
-  double _redPulse;
-  double _redStd;
-
-  FIR< LowPassKernel<firSize> >  _irDCFilter;
-  FIR< BandPassKernel<firSize> > _irACFilter;
-  FIR< LowPassKernel<firSize> >  _redDCFilter;
-  FIR< BandPassKernel<firSize> > _redACFilter;
-
-  double _SpO2;
-
-  bool   _isFalling;
-  double _lastPulse;
-  double _pulse;
-  double _pulseMean;
-
-  QFile _logFile;
+  /** The last raw ADC sums as received from the device. */
+  uint16_t _rawBase;
+  uint16_t _rawIr;
+  uint16_t _rawRed;
+
+  /** The signal processing. */
+  Processor _processor;
+
+  /** Serial number of the connected device. */
+  QString _serial;
+  /** Calibration curves for all known devices. */
+  Calibration _calibration;
+  /** Calibration curve of the connected device. */
+  CalibrationCurve _curve;
+
+  /** Text log and beat log, written asynchronously. */
+  AsyncWriter _logFile;
+  BinaryLogWriter _binaryLog;
+  ColumnarWriter _columnar;
+  RawLogWriter _rawLog;
+  EDFWriter _edf;
+  /** Downsample pyramid of the binary recordings. */
+  PyramidWriter _pyramid;
+  AsyncWriter _beatFile;
+  /** Reused buffers to assemble a row of the text log and the beat log. */
+  TextRow _row;
+  TextRow _beatRow;
+  /** Sync policy of the logs. */
+  AsyncWriter::SyncPolicy _logSyncPolicy;
+  unsigned long _logSyncInterval;
+  /** Segments of the log. */
+  SegmentedRecording _segments;
+  /** Number of rows and records dropped in the closed segments. */
+  quint64 _logDroppedBefore;
 
   bool _swapChannels;
 };
@@ -0,0 +1,288 @@
+#include "pyramid.hh"
+#include <QtGlobal>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+#define MAGIC "PULSEPYR"
+
+// The entries are accessed in place, hence they must not contain any padding
+Q_STATIC_ASSERT(sizeof(PyramidHeader) == 32);
+Q_STATIC_ASSERT(sizeof(PyramidEntry) == 16 + 12*PyramidEntry::COUNT);
+
+
+/** Resets the given entry to an empty aggregate. */
+static void
+clear(PyramidEntry &entry) {
+  entry.tFirst = entry.tLast = 0;
+  entry.count = entry.valid = 0;
+  for (int s=0; s<PyramidEntry::COUNT; s++)
+    entry.min[s] = entry.max[s] = entry.mean[s] = std::numeric_limits<float>::quiet_NaN();
+}
+
+
+/* ********************************************************************************************* *
+ * PyramidWriter
+ * ********************************************************************************************* */
+PyramidWriter::PyramidWriter()
+{
+  // The entries are small and rare, hence small buffers suffice
+  for (int i=0; i<levels; i++) {
+    _files[i] = new AsyncWriter(1<<12);
+    clear(_pending[i]);
+  }
+}
+
+PyramidWriter::~PyramidWriter() {
+  close();
+  for (int i=0; i<levels; i++)
+    delete _files[i];
+}
+
+int
+PyramidWriter::level(int i) {
+  return firstLevel + i*levelStep;
+}
+
+QString
+PyramidWriter::fileName(const QString &recording, int i) {
+  return recording + ".pyr" + QString::number(level(i));
+}
+
+bool
+PyramidWriter::open(const QString &recording, int64_t startTime) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Pyramids are not supported on big-endian hosts.";
+  return false;
+#endif
+  close();
+  PyramidHeader header;
+  memset(&header, 0, sizeof(PyramidHeader));
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version    = version;
+  header.headerSize = sizeof(PyramidHeader);
+  header.entrySize  = sizeof(PyramidEntry);
+  header.startTime  = startTime;
+  for (int i=0; i<levels; i++) {
+    header.level = level(i);
+    if ((! _files[i]->open(fileName(recording, i))) ||
+        (! _files[i]->write((const char *)&header, sizeof(PyramidHeader)))) {
+      close();
+      return false;
+    }
+    clear(_pending[i]);
+  }
+  return true;
+}
+
+bool
+PyramidWriter::isOpen() const {
+  return _files[0]->isOpen();
+}
+
+bool
+PyramidWriter::add(const BinaryLogRecord &record) {
+  if (! isOpen())
+    return false;
+
+  PyramidEntry sample;
+  sample.tFirst = sample.tLast = record.t;
+  sample.count = 1;
+  sample.valid = (record.flags & BinaryLogRecord::VALID) ? 1 : 0;
+  float values[PyramidEntry::COUNT] = { record.spo2, record.pulse, record.quality/255.f,
+                                        float(record.ir), float(record.red) };
+  for (int s=0; s<PyramidEntry::COUNT; s++) {
+    bool missing = (! sample.valid) && ((PyramidEntry::SPO2 == s) || (PyramidEntry::PULSE == s));
+    sample.min[s] = sample.max[s] = sample.mean[s] =
+        missing ? std::numeric_limits<float>::quiet_NaN() : values[s];
+  }
+  merge(_pending[0], sample);
+
+  if (_pending[0].count < (1u << level(0)))
+    return true;
+  return _emit(0);
+}
+
+void
+PyramidWriter::close() {
+  if (! isOpen())
+    return;
+  // Write the incomplete entries, each lower one is merged into the next level first
+  for (int i=0; i<levels; i++) {
+    if (_pending[i].count) {
+      _files[i]->write((const char *)&_pending[i], sizeof(PyramidEntry));
+      if ((i+1) < levels)
+        merge(_pending[i+1], _pending[i]);
+    }
+    clear(_pending[i]);
+    _files[i]->close();
+  }
+}
+
+void
+PyramidWriter::setSyncPolicy(AsyncWriter::SyncPolicy policy, unsigned long interval) {
+  for (int i=0; i<levels; i++)
+    _files[i]->setSyncPolicy(policy, interval);
+}
+
+quint64
+PyramidWriter::dropped() const {
+  quint64 count = 0;
+  for (int i=0; i<levels; i++)
+    count += _files[i]->dropped();
+  return count;
+}
+
+void
+PyramidWriter::merge(PyramidEntry &into, const PyramidEntry &from) {
+  if (0 == from.count)
+    return;
+  if (0 == into.count) {
+    into = from;
+    return;
+  }
+
+  into.tLast = from.tLast;
+  for (int s=0; s<PyramidEntry::COUNT; s++) {
+    // SpO2 and pulse rate are weighted by the number of valid samples
+    bool validOnly = (PyramidEntry::SPO2 == s) || (PyramidEntry::PULSE == s);
+    double n = validOnly ? into.valid : into.count, m = validOnly ? from.valid : from.count;
+    if (0 == m)
+      continue;
+    if (0 == n) {
+      into.min[s] = from.min[s]; into.max[s] = from.max[s]; into.mean[s] = from.mean[s];
+      continue;
+    }
+    into.min[s]  = std::min(into.min[s], from.min[s]);
+    into.max[s]  = std::max(into.max[s], from.max[s]);
+    into.mean[s] = (n*into.mean[s] + m*from.mean[s])/(n+m);
+  }
+  into.count += from.count;
+  into.valid += from.valid;
+}
+
+bool
+PyramidWriter::_emit(int i) {
+  bool ok = _files[i]->write((const char *)&_pending[i], sizeof(PyramidEntry));
+  if ((i+1) < levels) {
+    // Even if the entry got dropped, it is still part of the coarser levels
+    merge(_pending[i+1], _pending[i]);
+    if (_pending[i+1].count >= (1u << level(i+1)))
+      ok = _emit(i+1) && ok;
+  }
+  clear(_pending[i]);
+  return ok;
+}
+
+
+/* ********************************************************************************************* *
+ * Pyramid
+ * ********************************************************************************************* */
+Pyramid::Pyramid()
+{
+  for (int i=0; i<PyramidWriter::levels; i++) {
+    _levels[i].data = 0; _levels[i].entries = 0; _levels[i].count = 0;
+  }
+}
+
+Pyramid::~Pyramid() {
+  close();
+}
+
+bool
+Pyramid::open(const QString &recording, int64_t startTime) {
+  close();
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  return false;
+#endif
+  bool found = false;
+  for (int i=0; i<PyramidWriter::levels; i++) {
+    Level &level = _levels[i];
+    level.file.setFileName(PyramidWriter::fileName(recording, i));
+    if (! level.file.open(QIODevice::ReadOnly))
+      continue;
+    if ((level.file.size() < qint64(sizeof(PyramidHeader))) ||
+        (0 == (level.data = level.file.map(0, level.file.size())))) {
+      level.file.close();
+      continue;
+    }
+    const PyramidHeader &hdr = *reinterpret_cast<const PyramidHeader *>(level.data);
+    if ((0 != memcmp(hdr.magic, MAGIC, sizeof(hdr.magic))) || (0 == hdr.version) ||
+        (hdr.headerSize != sizeof(PyramidHeader)) || (hdr.entrySize != sizeof(PyramidEntry)) ||
+        (hdr.level != PyramidWriter::level(i)) || (hdr.startTime != startTime)) {
+      qDebug() << "Ignore invalid or outdated pyramid level" << level.file.fileName();
+      level.file.unmap(level.data);
+      level.file.close();
+      level.data = 0;
+      continue;
+    }
+    level.entries = reinterpret_cast<const PyramidEntry *>(level.data + hdr.headerSize);
+    // A truncated entry (e.g., after a crash) is ignored
+    level.count = (level.file.size() - hdr.headerSize)/sizeof(PyramidEntry);
+    found = true;
+  }
+  return found;
+}
+
+void
+Pyramid::close() {
+  for (int i=0; i<PyramidWriter::levels; i++) {
+    Level &level = _levels[i];
+    if (level.data)
+      level.file.unmap(level.data);
+    level.file.close();
+    level.data = 0; level.entries = 0; level.count = 0;
+  }
+}
+
+size_t
+Pyramid::size(int i) const {
+  return _levels[i].count;
+}
+
+size_t
+Pyramid::find(int i, uint32_t t) const {
+  size_t lo = 0, hi = _levels[i].count;
+  while (lo < hi) {
+    size_t mid = (lo+hi)/2;
+    if (_levels[i].entries[mid].tLast < t)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+size_t
+Pyramid::count(int i, uint32_t from, uint32_t to) const {
+  if (from >= to)
+    return 0;
+  size_t begin = find(i, from), end = find(i, to);
+  // The entry holding the end of the range overlaps it, if it starts before the end
+  if ((end < _levels[i].count) && (_levels[i].entries[end].tFirst < to))
+    end++;
+  return end - begin;
+}
+
+int
+Pyramid::select(uint32_t from, uint32_t to, size_t maxEntries) const {
+  int coarsest = -1;
+  for (int i=0; i<PyramidWriter::levels; i++) {
+    if (0 == _levels[i].data)
+      continue;
+    if (count(i, from, to) <= maxEntries)
+      return i;
+    coarsest = i;
+  }
+  return coarsest;
+}
+
+size_t
+Pyramid::read(int i, uint32_t from, uint32_t to, QVector<PyramidEntry> &entries) const {
+  size_t begin = find(i, from), n = count(i, from, to);
+  entries.resize(n);
+  if (n)
+    memcpy(entries.data(), _levels[i].entries + begin, n*sizeof(PyramidEntry));
+  return n;
+}
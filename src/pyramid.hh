@@ -0,0 +1,167 @@
+#ifndef PYRAMID_HH
+#define PYRAMID_HH
+
+#include <QString>
+#include <QFile>
+#include <QVector>
+#include "asyncwriter.hh"
+#include "binarylog.hh"
+#include <cinttypes>
+
+
+/** Header of a level of a downsample pyramid.
+ *
+ * The pyramid of a recording consists of one sidecar file per level (with the additional
+ * extension .pyr<level>), each holding this header followed by the aggregates of consecutive runs
+ * of 2^level samples. All values are stored in little-endian byte order. */
+struct PyramidHeader
+{
+  /** Magic bytes "PULSEPYR". */
+  char     magic[8];
+  /** Format version. */
+  uint16_t version;
+  /** Size of the header in bytes. */
+  uint16_t headerSize;
+  /** Size of each entry in bytes. */
+  uint16_t entrySize;
+  /** The level, i.e., the binary logarithm of the number of samples per entry. */
+  uint16_t level;
+  /** Start time of the recording in ms since epoch (UTC), identifies the recording. */
+  int64_t  startTime;
+  uint8_t  reserved[8];
+};
+
+
+/** Aggregate of a run of samples. */
+struct PyramidEntry
+{
+  /** The aggregated signals. */
+  typedef enum {
+    SPO2 = 0,   ///< SpO2, valid samples only.
+    PULSE,      ///< Pulse rate, valid samples only.
+    QUALITY,    ///< Signal quality in [0,1].
+    IR,         ///< Raw IR intensity.
+    RED,        ///< Raw RED intensity.
+    COUNT
+  } Signal;
+
+  /** Time of the first and last sample in ms since the start of the recording. */
+  uint32_t tFirst, tLast;
+  /** Number of samples and number of valid samples. The last entry of a level may hold less than
+   * 2^level samples. */
+  uint32_t count, valid;
+  /** Minimum, maximum and mean of each signal, NaN if there are no (valid) samples. */
+  float    min[COUNT], max[COUNT], mean[COUNT];
+};
+
+
+/** Maintains the downsample pyramid of a recording.
+ *
+ * The samples are aggregated into entries of the finest level. Each completed entry gets written
+ * and merged into the pending entry of the next level, hence building the pyramid costs O(1) per
+ * sample and the memory usage is one entry per level. The levels grow by a factor of 4, the
+ * finest level aggregates 16 samples (1.2 s at 75 ms) and the coarsest about 22 h. */
+class PyramidWriter
+{
+public:
+  /** Current format version. */
+  const static uint16_t version = 1;
+  /** Number of levels. */
+  const static int levels = 9;
+  /** The level (binary logarithm of the samples per entry) of the finest level. */
+  const static int firstLevel = 4;
+  /** The level increment between consecutive levels. */
+  const static int levelStep = 2;
+
+public:
+  PyramidWriter();
+  ~PyramidWriter();
+
+  /** Returns the level (binary logarithm of the number of samples per entry) of the i-th level. */
+  static int level(int i);
+  /** Returns the filename of the i-th level of the pyramid of the given recording. */
+  static QString fileName(const QString &recording, int i);
+
+  /** Creates the levels of the pyramid of the given recording. Returns @c false on error. */
+  bool open(const QString &recording, int64_t startTime);
+  /** Returns @c true if the pyramid is open. */
+  bool isOpen() const;
+  /** Adds a sample. Returns @c false if an entry got dropped. */
+  bool add(const BinaryLogRecord &record);
+  /** Writes the pending (incomplete) entries of all levels and closes the pyramid. */
+  void close();
+
+  /** Sets the sync policy of all levels (see @c AsyncWriter). */
+  void setSyncPolicy(AsyncWriter::SyncPolicy policy, unsigned long interval=0);
+  /** Returns the number of entries dropped. */
+  quint64 dropped() const;
+
+  /** Merges the aggregate @c from into @c into. */
+  static void merge(PyramidEntry &into, const PyramidEntry &from);
+
+protected:
+  /** Writes the pending entry of the i-th level and merges it into the next one. */
+  bool _emit(int i);
+
+private:
+  // Not copyable
+  PyramidWriter(const PyramidWriter &other);
+  PyramidWriter &operator=(const PyramidWriter &other);
+
+protected:
+  AsyncWriter *_files[levels];
+  /** The pending entry of each level. */
+  PyramidEntry _pending[levels];
+};
+
+
+/** Reader of a downsample pyramid.
+ *
+ * The levels get mapped into memory, hence opening costs constant time. Any time range is
+ * answered at the finest level holding no more entries than requested (e.g., the number of
+ * pixels), costing O(log n) for the search plus the number of entries read. */
+class Pyramid
+{
+public:
+  Pyramid();
+  ~Pyramid();
+
+  /** Maps the levels of the pyramid of the given recording. Levels that are missing or do not
+   * belong to the recording with the given start time are skipped. Returns @c false if there is
+   * no valid level at all. */
+  bool open(const QString &recording, int64_t startTime);
+  /** Unmaps all levels. */
+  void close();
+
+  /** Returns the number of entries of the i-th level. */
+  size_t size(int i) const;
+  /** Returns the j-th entry of the i-th level. */
+  inline const PyramidEntry &entry(int i, size_t j) const {
+    return _levels[i].entries[j];
+  }
+  /** Returns the index of the first entry of the i-th level ending at or after time @c t (in ms).
+   * If all entries precede @c t, the number of entries is returned. */
+  size_t find(int i, uint32_t t) const;
+  /** Returns the number of entries of the i-th level overlapping [from, to) ms. */
+  size_t count(int i, uint32_t from, uint32_t to) const;
+
+  /** Returns the finest level holding at most @c maxEntries entries within [from, to) ms, or the
+   * coarsest level if there is none. Returns -1 if no level is available. */
+  int select(uint32_t from, uint32_t to, size_t maxEntries) const;
+  /** Reads the entries of the i-th level overlapping [from, to) ms into @c entries. Returns the
+   * number of entries read. */
+  size_t read(int i, uint32_t from, uint32_t to, QVector<PyramidEntry> &entries) const;
+
+protected:
+  /** A mapped level. */
+  struct Level {
+    QFile file;
+    uchar *data;
+    const PyramidEntry *entries;
+    size_t count;
+  };
+
+  Level _levels[PyramidWriter::levels];
+};
+
+#endif // PYRAMID_HH
@@ -0,0 +1,170 @@
+#include "quality.hh"
+#include <cmath>
+#include <algorithm>
+
+/// Intensities closer than this to the limits of the ADC range are considered clipped
+/// (4 LSB of the 64-fold oversampled 10bit ADC).
+#define CLIP_MARGIN (256./0xffff)
+/// Perfusion index below which the signal is considered garbage.
+#define PI_MIN  5e-4
+/// Perfusion index above which the perfusion is considered good.
+#define PI_GOOD 5e-3
+/// Update rate of the beat template.
+#define TEMPLATE_RATE 0.2
+
+
+SignalQuality::SignalQuality(uint16_t window, double threshold)
+  : _window(std::max(uint16_t(1), window)), _threshold(threshold)
+{
+  reset();
+}
+
+void
+SignalQuality::reset() {
+  _count = _clipped = 0;
+  _sumPerfusion = 0;
+  _sumIrIr = _sumIrRed = _sumRedRed = 0;
+  _sumRateDev = _sumCorr = 0;
+  _beats = 0;
+  _beatSize = 0;
+  _hasTemplate = false;
+  _perfusion = _agreement = _correlation = _clipping = _index = 0;
+}
+
+void
+SignalQuality::addRaw(double base, double ir, double red) {
+  double lo = std::min(base, std::min(ir, red));
+  double hi = std::max(base, std::max(ir, red));
+  if ((lo < CLIP_MARGIN) || (hi > (1-CLIP_MARGIN)))
+    _clipped++;
+}
+
+bool
+SignalQuality::addSample(double irMean, double irPulse, double irStd, double redPulse) {
+  if (irMean > 0)
+    _sumPerfusion += irStd/irMean;
+  _sumIrIr   += irPulse*irPulse;
+  _sumIrRed  += irPulse*redPulse;
+  _sumRedRed += redPulse*redPulse;
+  if (_beatSize < maxBeatSize)
+    _beat[_beatSize++] = irPulse;
+
+  if (++_count < _window)
+    return false;
+
+  // Perfusion score
+  double pi = _sumPerfusion/_count;
+  _perfusion = std::min(1., std::max(0., (pi-PI_MIN)/(PI_GOOD-PI_MIN)));
+
+  // Agreement of IR and RED pulse signals and of consecutive beat rates
+  double norm = std::sqrt(_sumIrIr*_sumRedRed);
+  double channels = (norm > 0) ? std::max(0., _sumIrRed/norm) : 0;
+  double rates = _beats ? std::max(0., 1 - 2*_sumRateDev/_beats) : 0;
+  _agreement = channels*rates;
+
+  // Beat template correlation
+  _correlation = _beats ? _sumCorr/_beats : 0;
+
+  // Clipping
+  _clipping = std::min(1., double(_clipped)/_count);
+
+  _index = _perfusion * (_agreement + _correlation)/2 * (1-_clipping);
+
+  // Start next window
+  _count = _clipped = 0;
+  _sumPerfusion = 0;
+  _sumIrIr = _sumIrRed = _sumRedRed = 0;
+  _sumRateDev = _sumCorr = 0;
+  _beats = 0;
+  return true;
+}
+
+void
+SignalQuality::addBeat(double rate, double lastRate) {
+  if (lastRate > 0)
+    _sumRateDev += std::abs(rate-lastRate)/lastRate;
+  else
+    _sumRateDev += 1;
+  _processBeat();
+  _beats++;
+  _beatSize = 0;
+}
+
+void
+SignalQuality::_processBeat() {
+  if (_beatSize < 4)
+    return;
+
+  // Resample beat to template size
+  float beat[templateSize];
+  float mean = 0;
+  for (uint16_t i=0; i<templateSize; i++) {
+    float x = float(i*(_beatSize-1))/(templateSize-1);
+    uint16_t j = std::min(uint16_t(x), uint16_t(_beatSize-2));
+    float a = x-j;
+    beat[i] = (1-a)*_beat[j] + a*_beat[j+1];
+    mean += beat[i];
+  }
+  mean /= templateSize;
+
+  // Normalize to zero mean and unit norm
+  float norm = 0;
+  for (uint16_t i=0; i<templateSize; i++) {
+    beat[i] -= mean;
+    norm += beat[i]*beat[i];
+  }
+  if (0 == norm)
+    return;
+  norm = std::sqrt(norm);
+  for (uint16_t i=0; i<templateSize; i++)
+    beat[i] /= norm;
+
+  if (! _hasTemplate) {
+    std::copy(beat, beat+templateSize, _template);
+    _hasTemplate = true;
+  }
+
+  // Correlate with template and update template
+  float corr = 0; norm = 0;
+  for (uint16_t i=0; i<templateSize; i++) {
+    corr += beat[i]*_template[i];
+    _template[i] = (1-TEMPLATE_RATE)*_template[i] + TEMPLATE_RATE*beat[i];
+    norm += _template[i]*_template[i];
+  }
+  norm = std::sqrt(norm);
+  if (norm > 0) {
+    for (uint16_t i=0; i<templateSize; i++)
+      _template[i] /= norm;
+  }
+  _sumCorr += std::max(0.f, corr);
+}
+
+double
+SignalQuality::perfusion() const {
+  return _perfusion;
+}
+
+double
+SignalQuality::agreement() const {
+  return _agreement;
+}
+
+double
+SignalQuality::correlation() const {
+  return _correlation;
+}
+
+double
+SignalQuality::clipping() const {
+  return _clipping;
+}
+
+double
+SignalQuality::index() const {
+  return _index;
+}
+
+bool
+SignalQuality::isValid() const {
+  return _index >= _threshold;
+}
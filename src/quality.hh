@@ -0,0 +1,95 @@
+#ifndef QUALITY_HH
+#define QUALITY_HH
+
+#include <cinttypes>
+
+
+/** Estimates a signal quality index (SQI) for the pulse signal.
+ *
+ * The index is evaluated once per window of samples and combines four criteria: the perfusion
+ * (ratio of AC amplitude and DC level), the agreement between the IR and RED pulse signals as well
+ * as between the rates of consecutive beats, the correlation of each beat with a running beat
+ * template and the fraction of samples clipped by the ADC. The resulting index is in [0,1],
+ * where 0 means "garbage" (e.g., no finger inserted) and 1 means a perfect signal. */
+class SignalQuality
+{
+public:
+  /// Number of samples of the beat template.
+  const static uint16_t templateSize = 32;
+  /// Maximum number of samples buffered for a single beat.
+  const static uint16_t maxBeatSize = 64;
+
+public:
+  /** Constructor.
+   * @param window Specifies the number of samples per evaluation window.
+   * @param threshold Specifies the minimum index for the signal being considered valid. */
+  SignalQuality(uint16_t window, double threshold=0.5);
+
+  /** Resets the estimator, the signal is considered invalid until the first window is complete. */
+  void reset();
+
+  /** Checks the raw (normalized) intensities for clipping. */
+  void addRaw(double base, double ir, double red);
+  /** Adds the filtered IR and RED signals of the current sample. Returns @c true if the current
+   * window is complete and the quality index has been updated. */
+  bool addSample(double irMean, double irPulse, double irStd, double redPulse);
+  /** Adds a detected beat with the given rate and the rate of the preceding beat. The rate
+   * agreement must not depend on an estimate that gets only updated by a valid signal, otherwise
+   * the signal could never become valid again once the rate changed (e.g., under exercise). */
+  void addBeat(double rate, double lastRate);
+
+  /** Returns the perfusion score of the last window in [0,1]. */
+  double perfusion() const;
+  /** Returns the agreement score of the last window in [0,1]. */
+  double agreement() const;
+  /** Returns the beat template correlation score of the last window in [0,1]. */
+  double correlation() const;
+  /** Returns the fraction of clipped samples in the last window. */
+  double clipping() const;
+  /** Returns the signal quality index in [0,1]. */
+  double index() const;
+  /** Returns @c true if the quality index is above the threshold. */
+  bool isValid() const;
+
+protected:
+  /** Correlates the current beat with the template and updates the template. */
+  void _processBeat();
+
+protected:
+  /** Number of samples per window. */
+  uint16_t _window;
+  /** Minimum quality index of a valid signal. */
+  double _threshold;
+
+  /** Number of samples in the current window. */
+  uint16_t _count;
+  /** Number of clipped samples in the current window. */
+  uint16_t _clipped;
+  /** Sum of the perfusion index over the current window. */
+  double _sumPerfusion;
+  /** Sums of the products of IR & RED AC signals over the current window. */
+  double _sumIrIr, _sumIrRed, _sumRedRed;
+  /** Sum of the relative deviations of consecutive beat rates over the current window. */
+  double _sumRateDev;
+  /** Sum of the beat template correlations over the current window. */
+  double _sumCorr;
+  /** Number of beats in the current window. */
+  uint16_t _beats;
+
+  /** AC samples of the current beat. */
+  float _beat[maxBeatSize];
+  /** Number of samples of the current beat. */
+  uint16_t _beatSize;
+  /** The normalized beat template. */
+  float _template[templateSize];
+  /** If @c true, the template has been initialized. */
+  bool _hasTemplate;
+
+  double _perfusion;
+  double _agreement;
+  double _correlation;
+  double _clipping;
+  double _index;
+};
+
+#endif // QUALITY_HH
@@ -0,0 +1,319 @@
+#include "rawlog.hh"
+#include <QtGlobal>
+#include <QDebug>
+#include <cstring>
+#include <algorithm>
+
+#define MAGIC "PULSERAW"
+
+// The records are accessed in place, hence they must not contain any padding
+Q_STATIC_ASSERT(sizeof(RawLogHeader) == 64);
+Q_STATIC_ASSERT(sizeof(RawLogRecord) == 10);
+
+
+/* ********************************************************************************************* *
+ * RawLogWriter
+ * ********************************************************************************************* */
+RawLogWriter::RawLogWriter()
+  : _file(), _index(), _entrySamples(0), _offset(0), _samples(0), _seq(0), _lastSeq(0xffff),
+    _t(0)
+{
+  // pass...
+}
+
+bool
+RawLogWriter::open(const QString &filename, uint16_t period, int64_t startTime,
+                   const QString &serial)
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Raw logs are not supported on big-endian hosts.";
+  return false;
+#endif
+  if (! _file.open(filename))
+    return false;
+
+  RawLogHeader header;
+  memset(&header, 0, sizeof(RawLogHeader));
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version    = version;
+  header.headerSize = sizeof(RawLogHeader);
+  header.recordSize = sizeof(RawLogRecord);
+  header.period     = period;
+  header.startTime  = startTime;
+  QByteArray serialData = serial.toLatin1().left(sizeof(header.serial));
+  memcpy(header.serial, serialData.constData(), serialData.size());
+
+  _seq = 0; _lastSeq = 0xffff; _t = 0;
+  _entrySamples = 0; _offset = sizeof(RawLogHeader); _samples = 0;
+  // The index is optional, readers rebuild it if missing or incomplete
+  _index.open(filename, startTime);
+  return _file.write((const char *)&header, sizeof(RawLogHeader));
+}
+
+bool
+RawLogWriter::isOpen() const {
+  return _file.isOpen();
+}
+
+bool
+RawLogWriter::write(uint32_t t, uint16_t base, uint16_t ir, uint16_t red) {
+  // Times are relative to the last record written, dropped samples must not shift them
+  uint32_t dt = (t > _t) ? (t-_t) : 0;
+  RawLogRecord record;
+  record.seq  = _seq;
+  record.base = base; record.ir = ir; record.red = red;
+  if (dt <= 0xffff) {
+    record.dt = dt; _seq++;
+    if (! _file.write((const char *)&record, sizeof(RawLogRecord)))
+      return false;
+    _lastSeq = record.seq; _t = t;
+    _indexSample(_offset, t);
+    _offset += sizeof(RawLogRecord);
+    return true;
+  }
+
+  // Long gap (e.g., the device was disconnected): Prepend time records, they are handed over
+  // together with the sample, hence either all get logged or dropped
+  QByteArray buffer;
+  RawLogRecord gap;
+  gap.seq = _lastSeq; gap.dt = 0xffff;
+  gap.base = gap.ir = gap.red = 0;
+  for (; dt > 0xffff; dt -= 0xffff)
+    buffer.append((const char *)&gap, sizeof(RawLogRecord));
+  record.dt = dt; _seq++;
+  buffer.append((const char *)&record, sizeof(RawLogRecord));
+  if (! _file.write(buffer))
+    return false;
+  _lastSeq = record.seq; _t = t;
+  _offset += buffer.size();
+  _indexSample(_offset-sizeof(RawLogRecord), t);
+  return true;
+}
+
+void
+RawLogWriter::close() {
+  if (_index.isOpen() && _entrySamples)
+    _index.add(_entry);
+  _entrySamples = 0;
+  _index.close();
+  _file.close();
+}
+
+AsyncWriter &
+RawLogWriter::writer() {
+  return _file;
+}
+
+const AsyncWriter &
+RawLogWriter::writer() const {
+  return _file;
+}
+
+void
+RawLogWriter::_indexSample(uint64_t offset, uint32_t t) {
+  if (0 == _entrySamples) {
+    _entry.offset = offset;
+    _entry.row    = _samples;
+    _entry.tFirst = t;
+  }
+  _entry.tLast = t;
+  _samples++;
+  if (++_entrySamples == indexInterval) {
+    if (_index.isOpen())
+      _index.add(_entry);
+    _entrySamples = 0;
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * RawLogReader
+ * ********************************************************************************************* */
+RawLogReader::RawLogReader()
+  : _data(0), _records(0), _recordSize(0), _count(0), _samples(0)
+{
+  // pass...
+}
+
+RawLogReader::~RawLogReader() {
+  close();
+}
+
+bool
+RawLogReader::isRawLog(const QString &filename) {
+  QFile file(filename);
+  if (! file.open(QIODevice::ReadOnly))
+    return false;
+  return file.read(strlen(MAGIC)) == MAGIC;
+}
+
+bool
+RawLogReader::open(const QString &filename) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Raw logs are not supported on big-endian hosts.";
+  return false;
+#endif
+  close();
+  _file.setFileName(filename);
+  if (! _file.open(QIODevice::ReadOnly)) {
+    qDebug() << "Cannot open log" << filename << ":" << _file.errorString();
+    return false;
+  }
+  if (_file.size() < qint64(sizeof(RawLogHeader))) {
+    qDebug() << "Invalid log" << filename << ": Truncated header.";
+    _file.close();
+    return false;
+  }
+  if (0 == (_data = _file.map(0, _file.size()))) {
+    qDebug() << "Cannot map log" << filename << ":" << _file.errorString();
+    _file.close();
+    return false;
+  }
+
+  const RawLogHeader &hdr = header();
+  // Later versions only append fields, hence they can be read as well
+  if ((0 != memcmp(hdr.magic, MAGIC, sizeof(hdr.magic))) || (0 == hdr.version) ||
+      (0 == hdr.period) || (hdr.headerSize < sizeof(RawLogHeader)) ||
+      (hdr.recordSize < sizeof(RawLogRecord)) || (hdr.headerSize > _file.size())) {
+    qDebug() << "Invalid log" << filename << ": Unknown format.";
+    close();
+    return false;
+  }
+  _records    = _data + hdr.headerSize;
+  _recordSize = hdr.recordSize;
+  _count      = (_file.size() - hdr.headerSize)/_recordSize;
+
+  // Re-index the last indexed run (it may be incomplete) and all samples following it
+  if (_index.open(filename, hdr.startTime, _file.size()) && _index.size()) {
+    const TimeIndexEntry &last = _index.last();
+    uint64_t offset = last.offset - hdr.headerSize;
+    if ((last.offset >= hdr.headerSize) && (0 == (offset % _recordSize))) {
+      size_t rec = offset/_recordSize;
+      _index.resize(_index.size()-1);
+      if (rec < _count)
+        _indexRecords(rec, last.row, last.tFirst-_record(rec).dt, _record(rec).seq-1);
+      else
+        _samples = last.row;
+      return true;
+    }
+    qDebug() << "Ignore invalid index of" << filename;
+    _index.close();
+  }
+  _indexRecords(0, 0, 0, 0xffff);
+  return true;
+}
+
+void
+RawLogReader::close() {
+  if (_data)
+    _file.unmap(_data);
+  _file.close();
+  _data = 0; _records = 0;
+  _recordSize = _count = _samples = 0;
+  _index.close();
+}
+
+bool
+RawLogReader::isOpen() const {
+  return 0 != _data;
+}
+
+const RawLogHeader &
+RawLogReader::header() const {
+  return *reinterpret_cast<const RawLogHeader *>(_data);
+}
+
+size_t
+RawLogReader::size() const {
+  return _samples;
+}
+
+size_t
+RawLogReader::find(uint32_t t) const {
+  size_t i = _index.findTime(t);
+  if (i >= _index.size())
+    return _samples;
+  // Scan the run of the entry
+  const TimeIndexEntry &entry = _index.entry(i);
+  size_t rec = (entry.offset - header().headerSize)/_recordSize;
+  uint64_t row = entry.row;
+  uint32_t st = entry.tFirst;
+  if (st >= t)
+    return row;
+  uint16_t seq = _record(rec).seq;
+  for (rec++; rec<_count; rec++) {
+    const RawLogRecord &record = _record(rec);
+    st += record.dt;
+    if (record.seq == seq)
+      continue;
+    seq = record.seq; row++;
+    if (st >= t)
+      return row;
+  }
+  return _samples;
+}
+
+size_t
+RawLogReader::read(size_t begin, size_t count, Sample *out) const {
+  if ((begin >= _samples) || (0 == count))
+    return 0;
+  count = std::min(count, _samples-begin);
+  // Locate the run holding the first sample
+  const TimeIndexEntry &entry = _index.entry(_index.findRow(begin));
+  size_t rec = (entry.offset - header().headerSize)/_recordSize;
+  uint64_t row = entry.row;
+  uint32_t t = entry.tFirst - _record(rec).dt;
+  uint16_t seq = _record(rec).seq-1;
+  size_t n = 0;
+  for (; (rec < _count) && (n < count); rec++) {
+    const RawLogRecord &record = _record(rec);
+    t += record.dt;
+    if (record.seq == seq)
+      continue;
+    seq = record.seq;
+    if (row++ < begin)
+      continue;
+    Sample &sample = out[n++];
+    sample.t    = t;
+    sample.seq  = record.seq;
+    sample.base = record.base;
+    sample.ir   = record.ir;
+    sample.red  = record.red;
+  }
+  return n;
+}
+
+RawLogReader::Sample
+RawLogReader::sample(size_t i) const {
+  Sample sample;
+  memset(&sample, 0, sizeof(Sample));
+  read(i, 1, &sample);
+  return sample;
+}
+
+void
+RawLogReader::_indexRecords(size_t rec, uint64_t row, uint32_t t, uint16_t seq) {
+  TimeIndexEntry entry;
+  uint32_t n = 0;
+  for (; rec<_count; rec++) {
+    const RawLogRecord &record = _record(rec);
+    t += record.dt;
+    if (record.seq == seq)
+      continue;
+    seq = record.seq;
+    if (0 == n) {
+      entry.offset = header().headerSize + rec*_recordSize;
+      entry.row    = row;
+      entry.tFirst = t;
+    }
+    entry.tLast = t;
+    row++;
+    if (++n == RawLogWriter::indexInterval) {
+      _index.append(entry);
+      n = 0;
+    }
+  }
+  if (n)
+    _index.append(entry);
+  _samples = row;
+}
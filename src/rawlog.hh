@@ -0,0 +1,175 @@
+#ifndef RAWLOG_HH
+#define RAWLOG_HH
+
+#include <QString>
+#include <QFile>
+#include <QVector>
+#include "asyncwriter.hh"
+#include "timeindex.hh"
+#include <cinttypes>
+
+
+/** Header of a raw log file.
+ *
+ * A raw log stores the raw ADC sums as received from the device only, all derived values can be
+ * reproduced from them (see @c Rederivation). It consists of this header followed by fixed-size
+ * records. All values are stored in little-endian byte order. Like binary logs, later versions may
+ * only append fields to the header and the records. */
+struct RawLogHeader
+{
+  /** Magic bytes "PULSERAW". */
+  char     magic[8];
+  /** Format version. */
+  uint16_t version;
+  /** Size of the header in bytes. */
+  uint16_t headerSize;
+  /** Size of each record in bytes. */
+  uint16_t recordSize;
+  /** Nominal sample period in ms. */
+  uint16_t period;
+  /** Start of the recording in ms since epoch (UTC). */
+  int64_t  startTime;
+  /** Serial number of the device (0-terminated, if shorter). */
+  char     serial[32];
+  uint8_t  reserved[8];
+};
+
+
+/** A single record of a raw log.
+ *
+ * The sample time is stored as the time elapsed since the previous record. If that does not fit
+ * into 16 bits, the writer inserts time records. A time record repeats the sequence number of its
+ * predecessor and only advances the time, its intensities are meaningless. Gaps in the sequence
+ * numbers indicate dropped samples. */
+struct RawLogRecord
+{
+  /** Sequence number of the sample (wraps around). */
+  uint16_t seq;
+  /** Time in ms since the previous record (or the start of the recording). */
+  uint16_t dt;
+  /** Raw ADC sums of the base, IR and RED intensities as received from the device. */
+  uint16_t base, ir, red;
+};
+
+
+/** Writes a raw log along with its time index (see @c TimeIndexWriter). The records get written
+ * asynchronously (see @c AsyncWriter). */
+class RawLogWriter
+{
+public:
+  /** Current format version. */
+  const static uint16_t version = 1;
+  /** Number of samples per index entry. */
+  const static uint32_t indexInterval = 1024;
+
+public:
+  RawLogWriter();
+
+  /** Creates the log file and writes the header. Returns @c false on error. */
+  bool open(const QString &filename, uint16_t period, int64_t startTime, const QString &serial);
+  /** Returns @c true if a log file is open. */
+  bool isOpen() const;
+  /** Appends the sample taken @c t ms after the start of the recording. Returns @c false if the
+   * sample got dropped. */
+  bool write(uint32_t t, uint16_t base, uint16_t ir, uint16_t red);
+  /** Closes the log file and its index. */
+  void close();
+
+  /** Returns the writer (e.g., to set the sync policy or to obtain the drop counts). */
+  AsyncWriter &writer();
+  /** Returns the writer. */
+  const AsyncWriter &writer() const;
+
+protected:
+  /** Updates the index with the sample written at the given offset. */
+  void _indexSample(uint64_t offset, uint32_t t);
+
+protected:
+  AsyncWriter _file;
+  TimeIndexWriter _index;
+  /** Pending index entry and the number of samples in it. */
+  TimeIndexEntry _entry;
+  uint32_t _entrySamples;
+  /** Number of bytes and samples written. */
+  uint64_t _offset;
+  uint64_t _samples;
+  /** Sequence number of the next sample. */
+  uint16_t _seq;
+  /** Sequence number of the last record written. */
+  uint16_t _lastSeq;
+  /** Time of the last record written in ms. */
+  uint32_t _t;
+};
+
+
+/** Zero-copy reader of raw logs.
+ *
+ * The file gets mapped into memory. The samples are located by the time index of the log (see
+ * @c TimeIndex), hence opening, seeking and reading a window of samples cost O(log n) and do not
+ * depend on the length of the log. Samples not covered by the index (e.g., after a crash, or if the
+ * index is missing) get indexed on opening. An incomplete last record gets ignored. */
+class RawLogReader
+{
+public:
+  /** A sample of the log. */
+  struct Sample {
+    /** Time in ms since the start of the recording. */
+    uint32_t t;
+    /** Sequence number, gaps indicate lost samples. */
+    uint16_t seq;
+    /** Raw ADC sums. */
+    uint16_t base, ir, red;
+  };
+
+public:
+  RawLogReader();
+  ~RawLogReader();
+
+  /** Returns @c true if the given file starts with the raw log magic. */
+  static bool isRawLog(const QString &filename);
+
+  /** Maps the given log file. Returns @c false on error. */
+  bool open(const QString &filename);
+  /** Unmaps the file. */
+  void close();
+  /** Returns @c true if a log file is mapped. */
+  bool isOpen() const;
+
+  /** Returns the header of the log. */
+  const RawLogHeader &header() const;
+  /** Returns the number of samples. */
+  size_t size() const;
+  /** Returns the index of the first sample taken at or after @c t ms. Returns the number of
+   * samples if there is none. */
+  size_t find(uint32_t t) const;
+  /** Reads up to @c count samples starting at sample @c begin into @c out. Returns the number of
+   * samples read. */
+  size_t read(size_t begin, size_t count, Sample *out) const;
+  /** Returns the i-th sample. Use @c read to access consecutive samples. */
+  Sample sample(size_t i) const;
+
+protected:
+  /** Returns the i-th record. */
+  inline const RawLogRecord &_record(size_t i) const {
+    return *reinterpret_cast<const RawLogRecord *>(_records + i*_recordSize);
+  }
+  /** Indexes the records starting at record @c rec, whose first sample is the sample @c row.
+   * @c t and @c seq specify the time and the sequence number preceding that record. */
+  void _indexRecords(size_t rec, uint64_t row, uint32_t t, uint16_t seq);
+
+protected:
+  QFile _file;
+  /** The mapped file. */
+  uchar *_data;
+  /** Start of the records. */
+  const uchar *_records;
+  size_t _recordSize;
+  /** Number of records. */
+  size_t _count;
+  /** Number of samples. */
+  size_t _samples;
+  /** The time index. */
+  TimeIndex _index;
+};
+
+#endif // RAWLOG_HH
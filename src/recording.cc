@@ -0,0 +1,174 @@
+#include "recording.hh"
+#include "binarylog.hh"
+#include "columnar.hh"
+#include "rawlog.hh"
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+#include <QDebug>
+#include <algorithm>
+
+
+/** Normalizes a raw ADC sum. */
+static inline double
+normalize(uint16_t raw) {
+  return (0xffff-double(raw))/0xffff;
+}
+
+static bool
+readBinaryRecording(const QString &filename, Recording &recording, uint32_t from, uint32_t to) {
+  BinaryLogReader log;
+  if (! log.open(filename))
+    return false;
+  recording.hasBase = true;
+  recording.period  = log.header().period;
+  size_t begin = log.find(from), end = std::max(begin, log.find(to));
+  QVector<RawSample> &samples = recording.samples;
+  samples.resize(end-begin);
+  for (size_t i=begin; i<end; i++) {
+    const BinaryLogRecord &record = log.record(i);
+    RawSample &sample = samples[i-begin];
+    sample.t    = record.t/60e3;
+    sample.base = normalize(record.base);
+    sample.ir   = normalize(record.ir);
+    sample.red  = normalize(record.red);
+  }
+  return true;
+}
+
+static bool
+readColumnarRecording(const QString &filename, Recording &recording, uint32_t from, uint32_t to) {
+  ColumnarReader log;
+  if (! log.open(filename))
+    return false;
+  recording.hasBase = true;
+  recording.period  = log.header().period;
+  size_t begin = log.find(from), end = std::max(begin, log.find(to));
+  QVector<RawSample> &samples = recording.samples;
+  samples.resize(end-begin);
+  if (begin >= end)
+    return true;
+  // Decode the raw columns of the blocks overlapping the window only
+  QVector<double> t, base, ir, red;
+  for (size_t b=log.findBlock(begin); b<=log.findBlock(end-1); b++) {
+    ColumnarReader::Block block;
+    bool valid = log.block(b, block);
+    if (valid) {
+      t.resize(block.rows); base.resize(block.rows); ir.resize(block.rows); red.resize(block.rows);
+      valid = log.decodeColumn(b, COL_T, t.data()) && log.decodeColumn(b, COL_BASE, base.data()) &&
+          log.decodeColumn(b, COL_IR, ir.data()) && log.decodeColumn(b, COL_RED, red.data());
+    }
+    if (! valid) {
+      qDebug() << "Invalid recording" << filename << ": Corrupted block" << b;
+      samples.resize(std::max(begin, size_t(block.firstRow))-begin);
+      return true;
+    }
+    size_t first = std::max(begin, size_t(block.firstRow));
+    size_t last  = std::min(end, size_t(block.firstRow+block.rows));
+    for (size_t row=first; row<last; row++) {
+      size_t i = row-block.firstRow;
+      RawSample &sample = samples[row-begin];
+      sample.t    = t[i]/60e3;
+      sample.base = normalize(base[i]);
+      sample.ir   = normalize(ir[i]);
+      sample.red  = normalize(red[i]);
+    }
+  }
+  return true;
+}
+
+static bool
+readRawRecording(const QString &filename, Recording &recording, uint32_t from, uint32_t to) {
+  RawLogReader log;
+  if (! log.open(filename))
+    return false;
+  recording.hasBase = true;
+  recording.period  = log.header().period;
+  size_t begin = log.find(from), end = std::max(begin, log.find(to));
+  QVector<RawSample> &samples = recording.samples;
+  samples.resize(end-begin);
+  QVector<RawLogReader::Sample> raw(RawLogWriter::indexInterval);
+  for (size_t i=begin, n=0; i<end; i+=n) {
+    if (0 == (n = log.read(i, std::min(size_t(raw.size()), end-i), raw.data())))
+      break;
+    for (size_t j=0; j<n; j++) {
+      RawSample &sample = samples[i-begin+j];
+      sample.t    = raw[j].t/60e3;
+      sample.base = normalize(raw[j].base);
+      sample.ir   = normalize(raw[j].ir);
+      sample.red  = normalize(raw[j].red);
+    }
+  }
+  return true;
+}
+
+bool
+readRecording(const QString &filename, uint16_t period, Recording &recording,
+              uint32_t from, uint32_t to)
+{
+  if (BinaryLogReader::isBinaryLog(filename))
+    return readBinaryRecording(filename, recording, from, to);
+  if (ColumnarReader::isColumnar(filename))
+    return readColumnarRecording(filename, recording, from, to);
+  if (RawLogReader::isRawLog(filename))
+    return readRawRecording(filename, recording, from, to);
+
+  QFile file(filename);
+  if (! file.open(QIODevice::ReadOnly)) {
+    qDebug() << "Cannot open recording" << filename << ":" << file.errorString();
+    return false;
+  }
+
+  // Parse header, the delimiter is one of tab, ';' or ',' (see Pulse::setLogFormat)
+  QByteArray line = file.readLine().trimmed();
+  char delimiter = line.contains('\t') ? '\t' : (line.contains(';') ? ';' : ',');
+  QList<QByteArray> header = line.split(delimiter);
+  if (header.isEmpty() || (! header.first().startsWith('#'))) {
+    qDebug() << "Invalid recording" << filename << ": No header.";
+    return false;
+  }
+  header.first().remove(0, 1);
+  int irCol = header.indexOf("IR_RAW"), redCol = header.indexOf("RED_RAW"), tCol = header.indexOf("T");
+  if ((0 > irCol) || (0 > redCol)) {
+    qDebug() << "Invalid recording" << filename << ": No raw IR or RED column.";
+    return false;
+  }
+  int nCol = std::max(std::max(irCol, redCol), tCol)+1;
+
+  recording.hasBase = false;
+  recording.period  = period;
+  QVector<RawSample> &samples = recording.samples;
+  samples.clear();
+  for (size_t rows=0; ! file.atEnd(); ) {
+    QList<QByteArray> row = file.readLine().trimmed().split(delimiter);
+    if (row.size() < nCol)
+      continue;
+    RawSample sample;
+    sample.t    = (0 <= tCol) ? row[tCol].toDouble() : (rows++)*double(period)/60e3;
+    if ((sample.t*60e3 < from) || (sample.t*60e3 >= to))
+      continue;
+    sample.base = 0;
+    sample.ir   = row[irCol].toDouble();
+    sample.red  = row[redCol].toDouble();
+    samples.append(sample);
+  }
+
+  return true;
+}
+
+int64_t
+recordingStartTime(const QString &filename) {
+  if (BinaryLogReader::isBinaryLog(filename)) {
+    BinaryLogReader log;
+    return log.open(filename) ? log.header().startTime : 0;
+  }
+  if (ColumnarReader::isColumnar(filename)) {
+    ColumnarReader log;
+    return log.open(filename) ? log.header().startTime : 0;
+  }
+  if (RawLogReader::isRawLog(filename)) {
+    RawLogReader log;
+    return log.open(filename) ? log.header().startTime : 0;
+  }
+  return 0;
+}
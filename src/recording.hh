@@ -0,0 +1,48 @@
+#ifndef RECORDING_HH
+#define RECORDING_HH
+
+#include <QString>
+#include <QVector>
+#include <cinttypes>
+#include <limits>
+
+
+/** A raw sample of a recording. */
+struct RawSample
+{
+  /** Time in minutes since the start of the recording. */
+  double t;
+  /** The normalized raw intensities. */
+  double base, ir, red;
+};
+
+
+/** A recording loaded into memory. */
+struct Recording
+{
+  /** If @c false, the IR and RED intensities are stored with the base already subtracted and the
+   * base is unknown (0). */
+  bool hasBase;
+  /** Sample period in ms. */
+  uint16_t period;
+  /** The samples. */
+  QVector<RawSample> samples;
+};
+
+
+/** Reads the raw samples of the given recording taken within [from, to) ms after its start.
+ *
+ * Binary logs (see @c BinaryLogReader), columnar recordings (see @c ColumnarReader) and raw logs
+ * (see @c RawLogReader) store the raw intensities including the base. Text logs store the IR and
+ * RED intensities with the base already subtracted. If a text log has no time column, the sample
+ * times are derived from the given sample period (in ms). The period of the other formats is
+ * taken from their header. The binary formats locate the window in O(log n), text logs get
+ * parsed from the start. Returns @c false on error. */
+bool readRecording(const QString &filename, uint16_t period, Recording &recording,
+                   uint32_t from=0, uint32_t to=std::numeric_limits<uint32_t>::max());
+
+/** Returns the start time of the given recording in ms since epoch (UTC) or 0 if unknown (e.g.,
+ * for text logs). */
+int64_t recordingStartTime(const QString &filename);
+
+#endif // RECORDING_HH
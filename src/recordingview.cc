@@ -0,0 +1,317 @@
+#include "recordingview.hh"
+#include "rederive.hh"
+#include <QDebug>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// Windows holding up to this many samples per pixel are loaded at full resolution
+#define DETAIL_DENSITY 2
+// Without a pyramid, windows holding up to this many samples per pixel get aggregated
+#define AGGREGATE_DENSITY 32
+// Samples re-derived before the window of a raw log to let the filters settle
+#define WARMUP 4096
+// Wide windows of raw logs without a pyramid get re-derived at up to this many sampled positions
+#define RAW_SAMPLES 128
+
+
+/** Returns the minimum and maximum of the given values, ignoring NaN. */
+static inline void
+extend(double value, double &min, double &max) {
+  if (value == value) {
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * RecordingView::Series
+ * ********************************************************************************************* */
+void
+RecordingView::Series::clear() {
+  t.resize(0); value.resize(0); min.resize(0); max.resize(0);
+}
+
+void
+RecordingView::Series::add(double time, double v, double lower, double upper) {
+  t.append(time); value.append(v); min.append(lower); max.append(upper);
+}
+
+
+/* ********************************************************************************************* *
+ * RecordingView
+ * ********************************************************************************************* */
+RecordingView::RecordingView()
+  : _format(NONE), _hasPyramid(false), _medianDC(false), _startTime(0), _duration(0)
+{
+  // pass...
+}
+
+bool
+RecordingView::isSupported(const QString &filename) {
+  return BinaryLogReader::isBinaryLog(filename) || ColumnarReader::isColumnar(filename) ||
+      RawLogReader::isRawLog(filename);
+}
+
+bool
+RecordingView::open(const QString &filename, const Calibration &calibration, bool medianDC) {
+  close();
+  QString serial;
+  if (BinaryLogReader::isBinaryLog(filename)) {
+    if (! _binary.open(filename))
+      return false;
+    _format    = BINARY;
+    _startTime = _binary.header().startTime;
+    _duration  = _binary.size() ? _binary.record(_binary.size()-1).t : 0;
+  } else if (ColumnarReader::isColumnar(filename)) {
+    if (! _columnar.open(filename))
+      return false;
+    _format    = COLUMNAR;
+    _startTime = _columnar.header().startTime;
+    ColumnarReader::Block block;
+    if (_columnar.blockCount() && _columnar.block(_columnar.blockCount()-1, block))
+      _duration = block.columns[COL_T]->max;
+  } else if (RawLogReader::isRawLog(filename)) {
+    if (! _raw.open(filename))
+      return false;
+    _format    = RAW;
+    _startTime = _raw.header().startTime;
+    _duration  = _raw.size() ? _raw.sample(_raw.size()-1).t : 0;
+    serial = QString::fromLatin1(_raw.header().serial,
+                                 int(qstrnlen(_raw.header().serial, sizeof(_raw.header().serial))));
+  } else {
+    qDebug() << "Cannot view" << filename << ": Not a binary, columnar or raw recording.";
+    return false;
+  }
+  _curve = calibration.curve(serial);
+  _medianDC = medianDC;
+  _hasPyramid = _pyramid.open(filename, _startTime);
+  return true;
+}
+
+void
+RecordingView::close() {
+  _binary.close();
+  _columnar.close();
+  _raw.close();
+  _pyramid.close();
+  _format = NONE;
+  _hasPyramid = false;
+  _startTime = 0;
+  _duration = 0;
+  // Release the loaded window
+  _records = QVector<BinaryLogRecord>();
+  _entries = QVector<PyramidEntry>();
+  _spo2 = _pulse = _irPulse = _redPulse = Series();
+}
+
+bool
+RecordingView::isOpen() const {
+  return NONE != _format;
+}
+
+int64_t
+RecordingView::startTime() const {
+  return _startTime;
+}
+
+uint32_t
+RecordingView::duration() const {
+  return _duration;
+}
+
+bool
+RecordingView::load(uint32_t from, uint32_t to, int width) {
+  _spo2.clear(); _pulse.clear(); _irPulse.clear(); _redPulse.clear();
+  if ((! isOpen()) || (from >= to))
+    return false;
+  width = std::max(1, width);
+
+  size_t count = _count(from, to);
+  if (count <= size_t(DETAIL_DENSITY)*width) {
+    if (! _readRecords(from, to))
+      return false;
+    _loadRecords(from, 0);
+    return true;
+  }
+  if (_hasPyramid && _loadPyramid(from, to, width))
+    return false;
+  if ((count <= size_t(AGGREGATE_DENSITY)*width) && _readRecords(from, to)) {
+    _loadRecords(from, std::max(uint32_t(1), (to-from)/uint32_t(width)));
+    return false;
+  }
+  if (COLUMNAR == _format)
+    _loadBlocks(from, to);
+  else if (BINARY == _format)
+    _loadSampled(from, to, DETAIL_DENSITY*width);
+  else if (RAW == _format)
+    _loadSampled(from, to, std::min(DETAIL_DENSITY*width, RAW_SAMPLES));
+  return false;
+}
+
+size_t
+RecordingView::_count(uint32_t from, uint32_t to) const {
+  switch (_format) {
+  case BINARY: return _binary.find(to) - _binary.find(from);
+  case COLUMNAR: return _columnar.find(to) - _columnar.find(from);
+  case RAW: return _raw.find(to) - _raw.find(from);
+  case NONE: break;
+  }
+  return 0;
+}
+
+bool
+RecordingView::_readRecords(uint32_t from, uint32_t to) {
+  _records.resize(0);
+  if (BINARY == _format) {
+    for (size_t i=_binary.find(from), n=_binary.find(to); i<n; i++)
+      _records.append(_binary.record(i));
+  } else if (COLUMNAR == _format) {
+    size_t begin = _columnar.find(from), end = _columnar.find(to);
+    if (begin >= end)
+      return true;
+    QVector<BinaryLogRecord> block;
+    for (size_t i=_columnar.findBlock(begin), last=_columnar.findBlock(end-1); i<=last; i++) {
+      ColumnarReader::Block info;
+      if (! _columnar.block(i, info))
+        return false;
+      block.resize(int(info.rows));
+      if (! _columnar.decodeBlock(i, block.data()))
+        return false;
+      for (size_t j=0; j<info.rows; j++) {
+        if ((block[j].t >= from) && (block[j].t < to))
+          _records.append(block[j]);
+      }
+    }
+  } else if (RAW == _format) {
+    _rederive(_raw.find(from), _raw.find(to), 1);
+  }
+  return true;
+}
+
+void
+RecordingView::_rederive(size_t begin, size_t end, size_t step) {
+  // The warm-up starts on a fixed grid aligned to the periodic processing state, hence a sample
+  // gets the same values whichever window it is loaded with
+  size_t alignment = Processor(_raw.header().period).alignment();
+  size_t grid = (WARMUP+alignment-1)/alignment*alignment;
+  Rederivation derivation(_raw.header().period, _curve, _medianDC);
+  QVector<RawLogReader::Sample> samples(RawLogWriter::indexInterval);
+  for (size_t i=begin; i<end; ) {
+    // Re-derive the requested samples of the grid cell holding sample i from the previous cell on
+    size_t cell = i/grid*grid, start = (cell >= grid) ? (cell-grid) : 0;
+    size_t last = i + (std::min(end, cell+grid)-1-i)/step*step;
+    derivation.reset();
+    for (size_t j=start, n; (j<=last) && (0 != (n = _raw.read(j, samples.size(), samples.data())));
+         j+=n) {
+      for (size_t k=0; (k<n) && ((j+k)<=last); k++) {
+        const RawLogReader::Sample &s = samples[k];
+        const BinaryLogRecord &rec = derivation.update(s.t, s.base, s.ir, s.red);
+        if (((j+k) >= i) && (0 == (j+k-i)%step))
+          _records.append(rec);
+      }
+    }
+    i = last + step;
+  }
+}
+
+void
+RecordingView::_loadRecords(uint32_t from, uint32_t bucket) {
+  if (0 == bucket) {
+    foreach (const BinaryLogRecord &rec, _records) {
+      double t = rec.t/60e3;
+      if (rec.flags & BinaryLogRecord::VALID) {
+        _spo2.add(t, rec.spo2, rec.spo2, rec.spo2);
+        _pulse.add(t, rec.pulse, rec.pulse, rec.pulse);
+      }
+      _irPulse.add(t, rec.irPulse, rec.irPulse, rec.irPulse);
+      _redPulse.add(t, rec.redPulse, rec.redPulse, rec.redPulse);
+    }
+    return;
+  }
+
+  // Aggregate the valid samples of each bucket, the buckets are aligned to the window
+  const double inf = std::numeric_limits<double>::infinity();
+  for (int i=0; i<_records.size(); ) {
+    uint32_t index = (_records[i].t-from)/bucket;
+    double spo2 = 0, spo2Min = inf, spo2Max = -inf, pulse = 0, pulseMin = inf, pulseMax = -inf;
+    size_t valid = 0;
+    for (; (i<_records.size()) && (index == (_records[i].t-from)/bucket); i++) {
+      const BinaryLogRecord &rec = _records[i];
+      if (! (rec.flags & BinaryLogRecord::VALID))
+        continue;
+      spo2 += rec.spo2; extend(rec.spo2, spo2Min, spo2Max);
+      pulse += rec.pulse; extend(rec.pulse, pulseMin, pulseMax);
+      valid++;
+    }
+    if (0 == valid)
+      continue;
+    double t = (from + (index+0.5)*bucket)/60e3;
+    _spo2.add(t, spo2/valid, spo2Min, spo2Max);
+    _pulse.add(t, pulse/valid, pulseMin, pulseMax);
+  }
+}
+
+bool
+RecordingView::_loadPyramid(uint32_t from, uint32_t to, int width) {
+  int level = _pyramid.select(from, to, width);
+  if (level < 0)
+    return false;
+  _pyramid.read(level, from, to, _entries);
+  foreach (const PyramidEntry &e, _entries) {
+    if (0 == e.valid)
+      continue;
+    double t = 0.5*(double(e.tFirst) + double(e.tLast))/60e3;
+    _spo2.add(t, e.mean[PyramidEntry::SPO2], e.min[PyramidEntry::SPO2],
+              e.max[PyramidEntry::SPO2]);
+    _pulse.add(t, e.mean[PyramidEntry::PULSE], e.min[PyramidEntry::PULSE],
+               e.max[PyramidEntry::PULSE]);
+  }
+  return true;
+}
+
+void
+RecordingView::_loadBlocks(uint32_t from, uint32_t to) {
+  size_t begin = _columnar.find(from), end = _columnar.find(to);
+  if (begin >= end)
+    return;
+  // The block statistics give the range only, its center stands in for the mean
+  for (size_t i=_columnar.findBlock(begin), last=_columnar.findBlock(end-1); i<=last; i++) {
+    ColumnarReader::Block block;
+    if (! _columnar.block(i, block))
+      break;
+    const ColumnarColumn *spo2 = block.columns[COL_SPO2], *pulse = block.columns[COL_PULSE];
+    if ((spo2->min != spo2->min) || (pulse->min != pulse->min))
+      continue;
+    double t = 0.5*(block.columns[COL_T]->min + block.columns[COL_T]->max)/60e3;
+    _spo2.add(t, 0.5*(spo2->min+spo2->max), spo2->min, spo2->max);
+    _pulse.add(t, 0.5*(pulse->min+pulse->max), pulse->min, pulse->max);
+  }
+}
+
+void
+RecordingView::_loadSampled(uint32_t from, uint32_t to, int points) {
+  size_t begin, end;
+  if (RAW == _format) {
+    begin = _raw.find(from); end = _raw.find(to);
+  } else {
+    begin = _binary.find(from); end = _binary.find(to);
+  }
+  size_t step = std::max(size_t(1), (end-begin+points-1)/size_t(std::max(1, points)));
+  _records.resize(0);
+  if (RAW == _format) {
+    // Only the sampled positions get re-derived (each after its warm-up)
+    _rederive(begin, end, step);
+  } else {
+    for (size_t i=begin; i<end; i+=step)
+      _records.append(_binary.record(i));
+  }
+  foreach (const BinaryLogRecord &rec, _records) {
+    if (! (rec.flags & BinaryLogRecord::VALID))
+      continue;
+    double t = rec.t/60e3;
+    _spo2.add(t, rec.spo2, rec.spo2, rec.spo2);
+    _pulse.add(t, rec.pulse, rec.pulse, rec.pulse);
+  }
+}
@@ -0,0 +1,120 @@
+#ifndef RECORDINGVIEW_HH
+#define RECORDINGVIEW_HH
+
+#include "binarylog.hh"
+#include "columnar.hh"
+#include "rawlog.hh"
+#include "pyramid.hh"
+#include "calibration.hh"
+#include <QVector>
+
+
+/** Loads windows of a saved recording for display.
+ *
+ * Only the requested time window gets loaded, at a resolution matched to the width of the plot
+ * (in pixels), hence the memory usage is bounded by the width and does not depend on the length
+ * of the recording. The recording and its downsample pyramid (see @c Pyramid) are mapped into
+ * memory, the window is pulled from disk on demand. If the window holds few samples, they are
+ * loaded at full resolution (raw logs get re-derived, see @c Rederivation). Otherwise, the window
+ * is loaded as min/max/mean aggregates from the pyramid. Recordings without a pyramid fall back to
+ * aggregating the samples, to the block statistics (columnar recordings) or to sampling the
+ * records (binary and raw logs) for wide windows.
+ *
+ * Raw logs get re-derived on a fixed grid of samples: the samples of each grid cell are derived
+ * after warming up the filters over the previous cell. Hence a sample shows the same values
+ * whichever window it gets loaded with (e.g., while panning). */
+class RecordingView
+{
+public:
+  /** A loaded series, in minutes since the start of the recording. */
+  struct Series {
+    /** Time, value and range of each point. At full resolution, @c min and @c max equal the
+     * value. */
+    QVector<double> t, value, min, max;
+
+    /** Removes all points, keeping the memory. */
+    void clear();
+    /** Appends a point. */
+    void add(double t, double value, double min, double max);
+  };
+
+public:
+  RecordingView();
+
+  /** Returns @c true if the given file is a recording supported by the view (a binary log,
+   * columnar recording or raw log). */
+  static bool isSupported(const QString &filename);
+
+  /** Opens the given recording. The calibration and the DC filters (see
+   * @c Processor::setMedianDC) are used to re-derive raw logs. Returns @c false on error. */
+  bool open(const QString &filename, const Calibration &calibration, bool medianDC=false);
+  /** Closes the recording and releases the loaded window. */
+  void close();
+  /** Returns @c true if a recording is open. */
+  bool isOpen() const;
+
+  /** Returns the start of the recording in ms since epoch (UTC). */
+  int64_t startTime() const;
+  /** Returns the time of the last sample in ms since the start of the recording. */
+  uint32_t duration() const;
+
+  /** Loads the window [from, to) ms for a plot @c width pixels wide. Returns @c true if the
+   * samples were loaded at full resolution, in which case the pulse signals are loaded too. */
+  bool load(uint32_t from, uint32_t to, int width);
+
+  /** Returns the loaded SpO2 series (valid samples only). */
+  inline const Series &spo2() const { return _spo2; }
+  /** Returns the loaded pulse rate series (valid samples only). */
+  inline const Series &pulse() const { return _pulse; }
+  /** Returns the loaded IR pulse signal (full resolution only). */
+  inline const Series &irPulse() const { return _irPulse; }
+  /** Returns the loaded RED pulse signal (full resolution only). */
+  inline const Series &redPulse() const { return _redPulse; }
+
+protected:
+  /** Returns the number of samples within [from, to) ms. */
+  size_t _count(uint32_t from, uint32_t to) const;
+  /** Reads the records within [from, to) ms into @c _records. */
+  bool _readRecords(uint32_t from, uint32_t to);
+  /** Loads @c _records, aggregated into buckets of @c bucket ms if @c bucket is not 0. */
+  void _loadRecords(uint32_t from, uint32_t bucket);
+  /** Loads the aggregates of the pyramid. Returns @c false if there is no pyramid. */
+  bool _loadPyramid(uint32_t from, uint32_t to, int width);
+  /** Loads the block statistics of a columnar recording. */
+  void _loadBlocks(uint32_t from, uint32_t to);
+  /** Loads every n-th record of a binary or raw log, such that at most @c points records are
+   * loaded. */
+  void _loadSampled(uint32_t from, uint32_t to, int points);
+  /** Re-derives every @c step-th sample of the raw log, from the sample index @c begin up to
+   * @c end (exclusive), into @c _records. Each sample gets derived after warming up over the
+   * previous cell of the fixed grid, independent of @c begin. */
+  void _rederive(size_t begin, size_t end, size_t step);
+
+protected:
+  /** Supported formats. */
+  typedef enum {
+    NONE, BINARY, COLUMNAR, RAW
+  } Format;
+
+  Format _format;
+  BinaryLogReader _binary;
+  ColumnarReader _columnar;
+  RawLogReader _raw;
+  Pyramid _pyramid;
+  bool _hasPyramid;
+  /** Calibration curve of the device that took a raw log. */
+  CalibrationCurve _curve;
+  /** If @c true, raw logs get re-derived using the running median DC filters. */
+  bool _medianDC;
+  int64_t _startTime;
+  uint32_t _duration;
+
+  /** Buffer of the records read at full resolution. */
+  QVector<BinaryLogRecord> _records;
+  /** Buffer of pyramid entries. */
+  QVector<PyramidEntry> _entries;
+  /** The loaded window. */
+  Series _spo2, _pulse, _irPulse, _redPulse;
+};
+
+#endif // RECORDINGVIEW_HH
@@ -0,0 +1,98 @@
+#include "recovery.hh"
+#include "binarylog.hh"
+#include "columnar.hh"
+#include "rawlog.hh"
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+
+// Only the tail of a text log gets searched for the last line break
+#define TEXT_TAIL_SIZE (1<<16)
+
+
+/** Returns the size of the valid part of the given EDF+ file, patches its number of records.
+ * Returns -1 on error. */
+static qint64
+edfValidSize(QFile &file) {
+  QByteArray header = file.read(256);
+  if (header.size() < 256)
+    return -1;
+  qint64 headerSize = header.mid(184, 8).trimmed().toLongLong();
+  int ns = header.mid(252, 4).trimmed().toInt();
+  if ((headerSize != 256*(ns+1)) || (ns <= 0))
+    return -1;
+  // The numbers of samples per record follow the labels, transducers, dimensions, physical and
+  // digital ranges and prefilterings of all signals
+  QByteArray defs = file.read(headerSize-256);
+  if (defs.size() != (headerSize-256))
+    return -1;
+  qint64 recordSize = 0;
+  for (int i=0; i<ns; i++)
+    recordSize += 2*defs.mid(ns*216 + 8*i, 8).trimmed().toLongLong();
+  if (recordSize <= 0)
+    return -1;
+
+  qint64 records = std::max(qint64(0), (file.size()-headerSize)/recordSize);
+  QByteArray count = QByteArray::number(records).leftJustified(8, ' ', true);
+  if ((! file.seek(236)) || (count.size() != file.write(count)))
+    return -1;
+  return headerSize + records*recordSize;
+}
+
+/** Returns the size of the given text log up to its last line break. */
+static qint64
+textValidSize(QFile &file) {
+  qint64 offset = std::max(qint64(0), file.size()-TEXT_TAIL_SIZE);
+  if (! file.seek(offset))
+    return -1;
+  QByteArray tail = file.read(TEXT_TAIL_SIZE);
+  return offset + tail.lastIndexOf('\n') + 1;
+}
+
+bool
+recoverRecording(const QString &filename, qint64 *dropped) {
+  qint64 size = QFileInfo(filename).size(), valid = -1;
+  if (ColumnarReader::isColumnar(filename)) {
+    // Check every block, a block in the middle may be garbled as well (e.g., if the disk cache
+    // got written out of order)
+    ColumnarReader reader;
+    if (reader.open(filename))
+      valid = reader.verify();
+  } else if (BinaryLogReader::isBinaryLog(filename)) {
+    BinaryLogReader reader;
+    if (reader.open(filename))
+      valid = reader.header().headerSize + qint64(reader.size())*reader.header().recordSize;
+  } else if (RawLogReader::isRawLog(filename)) {
+    RawLogReader reader;
+    if (reader.open(filename))
+      valid = reader.header().headerSize + ((size-reader.header().headerSize)/
+                                            reader.header().recordSize)*reader.header().recordSize;
+  } else {
+    QFile file(filename);
+    if (! file.open(QIODevice::ReadWrite)) {
+      qDebug() << "Cannot recover" << filename << ":" << file.errorString();
+      return false;
+    }
+    if (0 == QFileInfo(filename).suffix().compare("edf", Qt::CaseInsensitive))
+      valid = edfValidSize(file);
+    else
+      valid = textValidSize(file);
+  }
+  if (valid < 0) {
+    qDebug() << "Cannot recover" << filename << ": Unknown or invalid format.";
+    return false;
+  }
+
+  if (dropped)
+    *dropped = size-valid;
+  if (valid >= size)
+    return true;
+  qDebug() << "Recover" << filename << ": Drop" << (size-valid) << "bytes of incomplete data.";
+  QFile file(filename);
+  if (! file.resize(valid)) {
+    qDebug() << "Cannot truncate" << filename << ":" << file.errorString();
+    return false;
+  }
+  return true;
+}
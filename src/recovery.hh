@@ -0,0 +1,18 @@
+#ifndef RECOVERY_HH
+#define RECOVERY_HH
+
+#include <QString>
+
+
+/** Recovers a recording after a crash.
+ *
+ * Truncates the given recording after its last complete unit: the last block of a columnar
+ * recording such that all blocks up to it are valid (i.e., every checksum gets checked), the last
+ * complete record of binary and raw logs, the last complete data record of an EDF+ file (updating
+ * the number of records in its header) and the last complete line of a text log. Sidecar files
+ * (e.g., the time index) need no recovery, as their readers ignore entries beyond the end of the
+ * recording. If @c dropped is given, it is set to the number of bytes dropped. Returns @c false on
+ * error. */
+bool recoverRecording(const QString &filename, qint64 *dropped=0);
+
+#endif // RECOVERY_HH
@@ -0,0 +1,67 @@
+#include "rederive.hh"
+#include <algorithm>
+
+
+void
+deriveRecord(const Processor &processor, const CalibrationCurve &curve, bool beat,
+             BinaryLogRecord &record)
+{
+  record.flags   = (processor.isValid() ? BinaryLogRecord::VALID : 0)
+      | (beat ? BinaryLogRecord::BEAT : 0);
+  record.quality = uint8_t(std::min(1., std::max(0., processor.quality()))*255 + 0.5);
+  record.spo2    = curve.eval(processor.ratio());
+  record.pulse   = processor.pulse();
+  record.irMean  = processor.irMean();  record.irPulse  = processor.irPulse();
+  record.irStd   = processor.irStd();
+  record.redMean = processor.redMean(); record.redPulse = processor.redPulse();
+  record.redStd  = processor.redStd();
+  record.ratio   = processor.ratio();
+}
+
+
+/* ********************************************************************************************* *
+ * Rederivation
+ * ********************************************************************************************* */
+Rederivation::Rederivation(uint16_t period, const CalibrationCurve &curve, bool medianDC)
+  : _processor(period), _curve(curve)
+{
+  _processor.setMedianDC(medianDC);
+}
+
+void
+Rederivation::reset() {
+  _processor.reset();
+}
+
+const BinaryLogRecord &
+Rederivation::update(uint32_t t, uint16_t base, uint16_t ir, uint16_t red) {
+  // Same time base and normalization as the live measurement (see Pulse::readMeasurement)
+  bool beat = _processor.update(t/60e3, (0xffff-double(base))/0xffff,
+                                (0xffff-double(ir))/0xffff, (0xffff-double(red))/0xffff);
+  _record.t    = t;
+  _record.base = base;
+  _record.ir   = ir;
+  _record.red  = red;
+  deriveRecord(_processor, _curve, beat, _record);
+  return _record;
+}
+
+const Processor &
+Rederivation::processor() const {
+  return _processor;
+}
+
+void
+Rederivation::rederive(const RawLogReader &log, const CalibrationCurve &curve,
+                       QVector<BinaryLogRecord> &records, bool medianDC)
+{
+  Rederivation derivation(log.header().period, curve, medianDC);
+  records.resize(log.size());
+  QVector<RawLogReader::Sample> samples(RawLogWriter::indexInterval);
+  for (size_t i=0, n; 0 != (n = log.read(i, samples.size(), samples.data())); i+=n) {
+    for (size_t j=0; j<n; j++) {
+      const RawLogReader::Sample &sample = samples[j];
+      records[i+j] = derivation.update(sample.t, sample.base, sample.ir, sample.red);
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef REDERIVE_HH
+#define REDERIVE_HH
+
+#include "processor.hh"
+#include "calibration.hh"
+#include "binarylog.hh"
+#include "rawlog.hh"
+#include <QVector>
+
+
+/** Fills the flags, the quality and the derived values of @c record from the current state of
+ * @c processor, applying the calibration curve @c curve to the ratio. This is the single
+ * definition of the derived columns, used by the live logging as well as by @c Rederivation. */
+void deriveRecord(const Processor &processor, const CalibrationCurve &curve, bool beat,
+                  BinaryLogRecord &record);
+
+
+/** Deterministically re-derives all values of a binary log record from the raw samples.
+ *
+ * Feeding the raw samples of a measurement (e.g., from a raw log, see @c RawLogReader) in order
+ * yields exactly the records the live logging would have written, provided the log was started
+ * together with the measurement. Otherwise, the results agree once the filters have settled. As
+ * the derivation runs the current @c Processor, recordings benefit from improved algorithms. */
+class Rederivation
+{
+public:
+  /** Constructor.
+   * @param period Specifies the sample period in ms.
+   * @param curve Specifies the calibration curve of the device.
+   * @param medianDC Selects the running median DC filters (see @c Processor::setMedianDC). */
+  Rederivation(uint16_t period, const CalibrationCurve &curve, bool medianDC=false);
+
+  /** Resets the processing state. */
+  void reset();
+  /** Processes the raw sample taken @c t ms after the start of the measurement and returns the
+   * derived record. */
+  const BinaryLogRecord &update(uint32_t t, uint16_t base, uint16_t ir, uint16_t red);
+  /** Returns the processor (e.g., to obtain the beat features). */
+  const Processor &processor() const;
+
+  /** Re-derives all records of the given raw log into @c records. */
+  static void rederive(const RawLogReader &log, const CalibrationCurve &curve,
+                       QVector<BinaryLogRecord> &records, bool medianDC=false);
+
+protected:
+  Processor _processor;
+  CalibrationCurve _curve;
+  BinaryLogRecord _record;
+};
+
+#endif // REDERIVE_HH
@@ -0,0 +1,61 @@
+#include "renderscheduler.hh"
+#include "qcustomplot.hh"
+#include <algorithm>
+#include <cmath>
+
+// Longest frame interval in ms, the plots get updated at least once per second
+#define MAX_INTERVAL 1000.
+
+
+/* ********************************************************************************************* *
+ * RenderScheduler
+ * ********************************************************************************************* */
+RenderScheduler::RenderScheduler(double maxFps, QObject *parent)
+  : QObject(parent), _timer(), _lastFrame(), _dirty(), _maxFps(1), _renderTime(0)
+{
+  setMaxFps(maxFps);
+  _timer.setSingleShot(true);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_onFrame()));
+}
+
+double
+RenderScheduler::maxFps() const {
+  return _maxFps;
+}
+
+void
+RenderScheduler::setMaxFps(double fps) {
+  _maxFps = std::max(1., fps);
+}
+
+double
+RenderScheduler::interval() const {
+  return std::min(MAX_INTERVAL, std::max(1e3/_maxFps, 2*_renderTime));
+}
+
+void
+RenderScheduler::update(QCustomPlot *plot) {
+  if (! _dirty.contains(plot))
+    _dirty.append(plot);
+  if (_timer.isActive())
+    return;
+  // Wait for the remainder of the frame interval
+  double delay = 0;
+  if (_lastFrame.isValid())
+    delay = std::max(0., interval() - _lastFrame.elapsed());
+  _timer.start(int(std::ceil(delay)));
+}
+
+void
+RenderScheduler::_onFrame() {
+  _lastFrame.start();
+  QList< QPointer<QCustomPlot> > dirty;
+  dirty.swap(_dirty);
+  foreach (QPointer<QCustomPlot> plot, dirty) {
+    if (plot && plot->isVisible())
+      plot->replot();
+  }
+  // Smooth the time spent replotting over the last few frames
+  double elapsed = _lastFrame.nsecsElapsed()/1e6;
+  _renderTime = (0 == _renderTime) ? elapsed : (0.8*_renderTime + 0.2*elapsed);
+}
@@ -0,0 +1,57 @@
+#ifndef RENDERSCHEDULER_HH
+#define RENDERSCHEDULER_HH
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QList>
+
+class QCustomPlot;
+
+
+/** Decouples replotting from the arrival of samples.
+ *
+ * Instead of replotting on every update, the plots get marked dirty (see @c update) and are
+ * replotted together with the next frame, hence there is at most one replot per plot and frame,
+ * independent of the sample rate. The frames are limited to the maximum frame rate. If replotting
+ * takes long (e.g., on a slow machine or with long time windows), the frame interval backs off,
+ * such that at most half of the time gets spent replotting. */
+class RenderScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param maxFps Specifies the maximum number of frames per second. */
+  explicit RenderScheduler(double maxFps=30, QObject *parent=0);
+
+  /** Returns the maximum number of frames per second. */
+  double maxFps() const;
+  /** Sets the maximum number of frames per second. */
+  void setMaxFps(double fps);
+  /** Returns the current interval between frames in ms, backed off from the maximum frame rate if
+   * replotting takes long. */
+  double interval() const;
+
+public slots:
+  /** Marks the given plot to be replotted with the next frame. */
+  void update(QCustomPlot *plot);
+
+protected slots:
+  /** Replots all dirty plots. */
+  void _onFrame();
+
+protected:
+  /** Triggers the frames. */
+  QTimer _timer;
+  /** Time since the start of the last frame. */
+  QElapsedTimer _lastFrame;
+  /** The plots to replot with the next frame. */
+  QList< QPointer<QCustomPlot> > _dirty;
+  double _maxFps;
+  /** Smoothed time spent replotting per frame in ms. */
+  double _renderTime;
+};
+
+#endif // RENDERSCHEDULER_HH
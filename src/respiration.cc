@@ -0,0 +1,85 @@
+#include "respiration.hh"
+#include <cmath>
+
+/// Lower bound of the respiratory band in 1/min
+#define RESP_MIN 6.
+/// Upper bound of the respiratory band in 1/min
+#define RESP_MAX 30.
+/// Time constant of the amplitude averages in 1/(decimated sample)
+#define RESP_THETA 0.05
+/// Update rate of the respiratory rate estimate per breath
+#define RESP_RATE_THETA 0.2
+/// Hysteresis of the breath detection
+#define RESP_HYST 0.3
+
+
+Respiration::Respiration(uint16_t period)
+  : _dcDecimator(LowPassKernel<decimatorSize>(0.8*0.5/factor)),
+    _acDecimator(LowPassKernel<decimatorSize>(0.8*0.5/factor)),
+    _dcFilter(BandPassKernel<firSize>(double(period)*factor*RESP_MIN/60e3,
+                                      double(period)*factor*RESP_MAX/60e3)),
+    _acFilter(BandPassKernel<firSize>(double(period)*factor*RESP_MIN/60e3,
+                                      double(period)*factor*RESP_MAX/60e3))
+{
+  reset();
+}
+
+void
+Respiration::reset() {
+  // Restart the decimation phase too, the processing state must not depend on earlier runs
+  _dcDecimator.reset();
+  _acDecimator.reset();
+  _dcFilter.reset();
+  _acFilter.reset();
+  _dcStd = _acStd = 0;
+  _coherence = 0;
+  _signal = 0;
+  _wasLow = false;
+  _lastBreath = -1;
+  _rate = 0;
+}
+
+bool
+Respiration::update(double t, Scalar dc, Scalar ac) {
+  // Decimate, both decimators are in phase
+  Scalar dcLow = 0, acLow = 0;
+  _acDecimator.apply(std::abs(ac), acLow);
+  if (! _dcDecimator.apply(dc, dcLow))
+    return false;
+  Scalar dcResp = _dcFilter.apply(dcLow);
+  Scalar acResp = _acFilter.apply(acLow);
+
+  // Normalize both signals and combine them with matching sign
+  _dcStd = (1.-RESP_THETA)*_dcStd + RESP_THETA*std::abs(dcResp);
+  _acStd = (1.-RESP_THETA)*_acStd + RESP_THETA*std::abs(acResp);
+  dcResp = (_dcStd > 0) ? dcResp/_dcStd : 0;
+  acResp = (_acStd > 0) ? acResp/_acStd : 0;
+  _coherence = (1.-RESP_THETA)*_coherence + RESP_THETA*dcResp*acResp;
+  _signal = dcResp + ((_coherence < 0) ? -acResp : acResp);
+
+  // Detect breath as rising zero-crossing
+  if (_signal < -RESP_HYST) {
+    _wasLow = true;
+  } else if (_wasLow && (_signal > RESP_HYST)) {
+    _wasLow = false;
+    double dt = t - _lastBreath;
+    if ((0 <= _lastBreath) && (0 < dt)) {
+      double f = 1./dt;
+      if ((f >= RESP_MIN/2) && (f <= 2*RESP_MAX))
+        _rate = (0 == _rate) ? f : (1.-RESP_RATE_THETA)*_rate + RESP_RATE_THETA*f;
+    }
+    _lastBreath = t;
+  }
+
+  return true;
+}
+
+double
+Respiration::signal() const {
+  return _signal;
+}
+
+double
+Respiration::rate() const {
+  return _rate;
+}
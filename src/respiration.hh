@@ -0,0 +1,69 @@
+#ifndef RESPIRATION_HH
+#define RESPIRATION_HH
+
+#include "fir.hh"
+
+
+/** Estimates the respiratory rate from the baseline wander (DC) and the amplitude modulation (AC
+ * amplitude) of the PPG signal.
+ *
+ * Both signals are decimated by a fixed factor and processed by a low-rate filter chain, hence
+ * the respiratory rate estimation runs at a fraction of the acquisition rate. The respiratory
+ * signal is the sum of the normalized band-passed DC and AC amplitude signals. Breaths are
+ * detected as rising zero-crossings (with some hysteresis) of the respiratory signal. */
+class Respiration
+{
+public:
+  /// Decimation factor.
+  const static uint16_t factor = 8;
+  /// Filter kernel size of the decimation filters in samples.
+  const static uint16_t decimatorSize = 32;
+  /// Filter kernel size of the low-rate band-pass filters in (decimated) samples.
+  const static uint16_t firSize = 32;
+
+public:
+  /** Constructor.
+   * @param period Specifies the sample period of the acquisition in ms. */
+  Respiration(uint16_t period);
+
+  /** Resets the estimator, including the state of its filters and the decimation phase. */
+  void reset();
+
+  /** Processes a sample of the DC and AC signal at time @c t (in minutes). Returns @c true if a
+   * decimated sample has been processed. */
+  bool update(double t, Scalar dc, Scalar ac);
+
+  /** Returns the current respiratory signal. */
+  double signal() const;
+  /** Returns the current estimate of the respiratory rate in breaths per minute. */
+  double rate() const;
+
+protected:
+  /** Decimation filter of the DC signal. */
+  Decimator< LowPassKernel<decimatorSize>, factor > _dcDecimator;
+  /** Decimation filter of the AC amplitude. */
+  Decimator< LowPassKernel<decimatorSize>, factor > _acDecimator;
+
+  /** Band-pass filter of the decimated DC signal. */
+  FIR< BandPassKernel<firSize> > _dcFilter;
+  /** Band-pass filter of the decimated AC amplitude. */
+  FIR< BandPassKernel<firSize> > _acFilter;
+  /** Mean amplitude of the band-passed DC signal. */
+  double _dcStd;
+  /** Mean amplitude of the band-passed AC amplitude. */
+  double _acStd;
+  /** Mean correlation of the normalized DC and AC amplitude signals, defines their relative
+   * sign. */
+  double _coherence;
+
+  /** The respiratory signal. */
+  double _signal;
+  /** If @c true, the respiratory signal was below the lower threshold. */
+  bool _wasLow;
+  /** Time of the last breath. */
+  double _lastBreath;
+  /** Smoothed respiratory rate. */
+  double _rate;
+};
+
+#endif // RESPIRATION_HH
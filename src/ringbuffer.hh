@@ -0,0 +1,78 @@
+#ifndef RINGBUFFER_HH
+#define RINGBUFFER_HH
+
+#include <vector>
+#include <cstddef>
+
+
+/** Double-ended queue kept in a single contiguous circular buffer.
+ *
+ * Appending and removing elements at either end cost amortized O(1) and do not allocate once the
+ * buffer has grown to the maximum number of elements held, random access is O(1). The capacity is
+ * a power of two, hence the position of an element in the buffer is a mask of its index. The
+ * buffer never shrinks, hence clearing keeps the memory for reuse. */
+template <class T>
+class RingBuffer
+{
+public:
+  /** Constructs an empty buffer. */
+  RingBuffer()
+    : _buffer(16), _mask(15), _head(0), _size(0)
+  {
+    // pass...
+  }
+
+  /** Returns the number of elements. */
+  inline size_t size() const { return _size; }
+  /** Returns @c true if there are no elements. */
+  inline bool isEmpty() const { return 0 == _size; }
+  /** Removes all elements, keeping the memory. */
+  inline void clear() { _head = _size = 0; }
+
+  /** Returns the i-th element, counted from the first (oldest) one. */
+  inline const T &operator[](size_t i) const { return _buffer[(_head+i) & _mask]; }
+  /** Returns the i-th element, counted from the first (oldest) one. */
+  inline T &operator[](size_t i) { return _buffer[(_head+i) & _mask]; }
+  /** Returns the first element. The buffer must not be empty. */
+  inline const T &first() const { return _buffer[_head]; }
+  /** Returns the last element. The buffer must not be empty. */
+  inline const T &last() const { return _buffer[(_head+_size-1) & _mask]; }
+
+  /** Appends an element. */
+  inline void append(const T &value) {
+    if (_size == _buffer.size())
+      _grow();
+    _buffer[(_head+_size) & _mask] = value;
+    _size++;
+  }
+  /** Removes the first element. The buffer must not be empty. */
+  inline void removeFirst() {
+    _head = (_head+1) & _mask;
+    _size--;
+  }
+  /** Removes the last element. The buffer must not be empty. */
+  inline void removeLast() {
+    _size--;
+  }
+
+protected:
+  /** Doubles the capacity, moving the elements to the start of the new buffer. */
+  void _grow() {
+    std::vector<T> buffer(2*_buffer.size());
+    for (size_t i=0; i<_size; i++)
+      buffer[i] = (*this)[i];
+    _buffer.swap(buffer);
+    _mask = _buffer.size()-1;
+    _head = 0;
+  }
+
+protected:
+  std::vector<T> _buffer;
+  /** Capacity - 1. */
+  size_t _mask;
+  /** Position of the first element in the buffer. */
+  size_t _head;
+  size_t _size;
+};
+
+#endif // RINGBUFFER_HH
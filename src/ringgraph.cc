@@ -0,0 +1,360 @@
+#include "ringgraph.hh"
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+
+/** Appends the point at the given pixel coordinates along the key and value axes. */
+static inline void
+appendPixel(QVector<QPointF> &points, double key, double value, bool horizontal) {
+  points.append(horizontal ? QPointF(key, value) : QPointF(value, key));
+}
+
+
+/* ********************************************************************************************* *
+ * RingGraph
+ * ********************************************************************************************* */
+RingGraph::RingGraph(QCPAxis *keyAxis, QCPAxis *valueAxis)
+  : QCPAbstractPlottable(keyAxis, valueAxis), _data(), _first(0), _min(), _max(),
+    _channelFillGraph(), _line(), _fill(), _scrolling(false), _strip(), _stripValid(false),
+    _stripKey(0), _stripScale(0), _stripLast(0), _stripValueRange(), _stripPen()
+{
+  setPen(QPen(Qt::blue, 0));
+  setBrush(Qt::NoBrush);
+  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
+  setSelectedBrush(Qt::NoBrush);
+}
+
+size_t
+RingGraph::size() const {
+  return _data.size();
+}
+
+const RingGraph::Data &
+RingGraph::at(size_t i) const {
+  return _data[i];
+}
+
+void
+RingGraph::addData(double key, double value) {
+  // A key going back in time (e.g., a restarted measurement) would break the order of the data
+  if ((! _data.isEmpty()) && (key < _data.last().key))
+    clearData();
+  Data data = { key, value };
+  _pushExtrema(_first+_data.size(), value);
+  _data.append(data);
+}
+
+void
+RingGraph::setData(const QVector<double> &keys, const QVector<double> &values) {
+  clearData();
+  for (int i=0; i<std::min(keys.size(), values.size()); i++)
+    addData(keys[i], values[i]);
+}
+
+void
+RingGraph::removeDataBefore(double key) {
+  while ((! _data.isEmpty()) && (_data.first().key < key)) {
+    if ((! _min.isEmpty()) && (_first == _min.first().index))
+      _min.removeFirst();
+    if ((! _max.isEmpty()) && (_first == _max.first().index))
+      _max.removeFirst();
+    _data.removeFirst();
+    _first++;
+  }
+}
+
+void
+RingGraph::clearData() {
+  _data.clear();
+  _min.clear();
+  _max.clear();
+  _first = 0;
+  _stripValid = false;
+}
+
+void
+RingGraph::setChannelFillGraph(RingGraph *graph) {
+  if (graph == this)
+    graph = 0;
+  _channelFillGraph = graph;
+}
+
+bool
+RingGraph::scrolling() const {
+  return _scrolling;
+}
+
+void
+RingGraph::setScrolling(bool enabled) {
+  _scrolling = enabled;
+  _stripValid = false;
+  // Release the strip
+  if (! _scrolling)
+    _strip = QPixmap();
+}
+
+double
+RingGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const {
+  Q_UNUSED(details);
+  if ((onlySelectable && (! mSelectable)) || _data.isEmpty() || (! mKeyAxis) || (! mValueAxis))
+    return -1;
+  if (! mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint()))
+    return -1;
+
+  double key, value;
+  pixelsToCoords(pos, key, value);
+  size_t i = _lowerBound(key), n = _data.size();
+  if (1 == n) {
+    QPointF d = coordsToPixels(_data[0].key, _data[0].value) - pos;
+    return std::sqrt(d.x()*d.x() + d.y()*d.y());
+  }
+  // Distance to the segments adjacent to the key
+  double dist = std::numeric_limits<double>::max();
+  for (size_t j=std::max(size_t(1), (i>0) ? i-1 : 0); j<=std::min(i+1, n-1); j++) {
+    dist = std::min(dist, distSqrToLine(coordsToPixels(_data[j-1].key, _data[j-1].value),
+                                        coordsToPixels(_data[j].key, _data[j].value), pos));
+  }
+  return std::sqrt(dist);
+}
+
+void
+RingGraph::draw(QCPPainter *painter) {
+  if ((! mKeyAxis) || (! mValueAxis) || _data.isEmpty())
+    return;
+  if (_scrolling && _drawStrip(painter))
+    return;
+  _visiblePoints(_line);
+  if (_line.size() < 2)
+    return;
+
+  if (_channelFillGraph && (Qt::NoBrush != mainBrush().style())) {
+    _channelFillGraph->_visiblePoints(_fill);
+    if (_fill.size()) {
+      // The line followed by the other graph in reverse order
+      QPolygonF polygon(_line.size() + _fill.size());
+      std::copy(_line.constBegin(), _line.constEnd(), polygon.begin());
+      std::reverse_copy(_fill.constBegin(), _fill.constEnd(), polygon.begin()+_line.size());
+      applyFillAntialiasingHint(painter);
+      painter->setPen(Qt::NoPen);
+      painter->setBrush(mainBrush());
+      painter->drawPolygon(polygon);
+    }
+  }
+
+  if ((Qt::NoPen != mainPen().style()) && (0 != mainPen().color().alpha())) {
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mainPen());
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPolyline(_line.constData(), _line.size());
+  }
+}
+
+void
+RingGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const {
+  if (Qt::NoBrush != mBrush.style()) {
+    applyFillAntialiasingHint(painter);
+    painter->fillRect(QRectF(rect.left(), rect.top()+rect.height()/2.0,
+                             rect.width(), rect.height()/3.0), mBrush);
+  }
+  applyDefaultAntialiasingHint(painter);
+  painter->setPen(mPen);
+  painter->drawLine(QLineF(rect.left(), rect.top()+rect.height()/2.0,
+                           rect.right()+5, rect.top()+rect.height()/2.0));
+}
+
+QCPRange
+RingGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain) const {
+  QCPRange range;
+  foundRange = false;
+  if (_data.isEmpty())
+    return range;
+  // The keys are sorted
+  if (sdBoth == inSignDomain) {
+    foundRange = true;
+    return QCPRange(_data.first().key, _data.last().key);
+  }
+  for (size_t i=0; i<_data.size(); i++) {
+    double key = _data[i].key;
+    if (((sdPositive == inSignDomain) && (key <= 0)) ||
+        ((sdNegative == inSignDomain) && (key >= 0)))
+      continue;
+    if (! foundRange)
+      range.lower = range.upper = key;
+    range.lower = std::min(range.lower, key);
+    range.upper = std::max(range.upper, key);
+    foundRange = true;
+  }
+  return range;
+}
+
+QCPRange
+RingGraph::getValueRange(bool &foundRange, SignDomain inSignDomain) const {
+  QCPRange range;
+  foundRange = false;
+  // The extrema are at hand, unless restricted to a sign domain (e.g., for logarithmic axes)
+  if (sdBoth == inSignDomain) {
+    if (_min.isEmpty())
+      return range;
+    foundRange = true;
+    return QCPRange(_min.first().value, _max.first().value);
+  }
+  for (size_t i=0; i<_data.size(); i++) {
+    double value = _data[i].value;
+    if (qIsNaN(value) ||
+        ((sdPositive == inSignDomain) && (value <= 0)) ||
+        ((sdNegative == inSignDomain) && (value >= 0)))
+      continue;
+    if (! foundRange)
+      range.lower = range.upper = value;
+    range.lower = std::min(range.lower, value);
+    range.upper = std::max(range.upper, value);
+    foundRange = true;
+  }
+  return range;
+}
+
+void
+RingGraph::_pushExtrema(size_t index, double value) {
+  if (qIsNaN(value))
+    return;
+  // Drop the candidates that can no longer become the extremum
+  while ((! _min.isEmpty()) && (_min.last().value >= value))
+    _min.removeLast();
+  while ((! _max.isEmpty()) && (_max.last().value <= value))
+    _max.removeLast();
+  Extremum extremum = { index, value };
+  _min.append(extremum);
+  _max.append(extremum);
+}
+
+size_t
+RingGraph::_lowerBound(double key) const {
+  size_t lower = 0, upper = _data.size();
+  while (lower < upper) {
+    size_t mid = (lower+upper)/2;
+    if (_data[mid].key < key)
+      lower = mid+1;
+    else
+      upper = mid;
+  }
+  return lower;
+}
+
+void
+RingGraph::_visiblePoints(QVector<QPointF> &points) const {
+  points.resize(0);
+  QCPAxis *keyAxis = mKeyAxis.data(), *valueAxis = mValueAxis.data();
+  QCPRange range = keyAxis->range();
+  // Include the points next to the range, such that the line reaches the edges of the plot
+  size_t begin = _lowerBound(range.lower), end = std::min(_lowerBound(range.upper)+1, _data.size());
+  if (begin > 0)
+    begin--;
+  bool horizontal = (Qt::Horizontal == keyAxis->orientation());
+  double pixels = std::abs(keyAxis->coordToPixel(range.upper)-keyAxis->coordToPixel(range.lower));
+
+  if (double(end-begin) <= 2*pixels) {
+    for (size_t i=begin; i<end; i++) {
+      if (! qIsNaN(_data[i].value))
+        points.append(coordsToPixels(_data[i].key, _data[i].value));
+    }
+    return;
+  }
+
+  // Reduce the points to the minimum and maximum of each pixel column
+  bool empty = true;
+  int column = 0;
+  double min = 0, max = 0;
+  for (size_t i=begin; i<end; i++) {
+    if (qIsNaN(_data[i].value))
+      continue;
+    int c = int(keyAxis->coordToPixel(_data[i].key));
+    double v = valueAxis->coordToPixel(_data[i].value);
+    if ((! empty) && (c == column)) {
+      min = std::min(min, v);
+      max = std::max(max, v);
+      continue;
+    }
+    if (! empty) {
+      appendPixel(points, column, min, horizontal);
+      appendPixel(points, column, max, horizontal);
+    }
+    column = c; min = max = v; empty = false;
+  }
+  if (! empty) {
+    appendPixel(points, column, min, horizontal);
+    appendPixel(points, column, max, horizontal);
+  }
+}
+
+bool
+RingGraph::_drawStrip(QCPPainter *painter) {
+  QCPAxis *keyAxis = mKeyAxis.data(), *valueAxis = mValueAxis.data();
+  // Exports, channel fills and other axis types get drawn as usual
+  if (_channelFillGraph || (Qt::Horizontal != keyAxis->orientation()) ||
+      keyAxis->rangeReversed() || (QCPAxis::stLinear != keyAxis->scaleType()) ||
+      painter->modes().testFlag(QCPPainter::pmVectorized) ||
+      painter->modes().testFlag(QCPPainter::pmNoCaching))
+    return false;
+
+  QRect rect = clipRect();
+  QCPRange range = keyAxis->range();
+  if (rect.isEmpty() || (range.size() <= 0))
+    return false;
+  double scale = rect.width()/range.size();
+  // Pixels the key range moved since the strip was shifted the last time
+  double offset = (range.lower-_stripKey)*scale;
+  size_t begin;
+  if (_stripValid && (_strip.size() == rect.size()) && (scale == _stripScale) &&
+      (valueAxis->range() == _stripValueRange) && (mainPen() == _stripPen) &&
+      (offset >= 0) && (offset < rect.width())) {
+    int shift = int(offset);
+    if (shift > 0) {
+      _strip.scroll(-shift, 0, _strip.rect());
+      QPainter clear(&_strip);
+      clear.setCompositionMode(QPainter::CompositionMode_Clear);
+      clear.fillRect(rect.width()-shift, 0, shift, rect.height(), Qt::transparent);
+      _stripKey += shift/scale;
+      offset -= shift;
+    }
+    // Continue the line from the last point rendered
+    begin = _lowerBound(_stripLast);
+  } else {
+    if (_strip.size() != rect.size())
+      _strip = QPixmap(rect.size());
+    _strip.fill(Qt::transparent);
+    _stripKey = range.lower;
+    _stripScale = scale;
+    _stripValueRange = valueAxis->range();
+    _stripPen = mainPen();
+    _stripValid = true;
+    offset = 0;
+    // Start with the point preceding the range, such that the line reaches the left edge
+    begin = _lowerBound(range.lower);
+    if (begin > 0)
+      begin--;
+    _stripLast = (begin < _data.size()) ? _data[begin].key : range.lower;
+  }
+
+  // Render the points up to the end of the range, later ones once they get visible
+  size_t end = _lowerBound(range.upper);
+  if ((end < _data.size()) && (_data[end].key == range.upper))
+    end++;
+  if (end > begin+1) {
+    _line.resize(0);
+    for (size_t i=begin; i<end; i++) {
+      if (! qIsNaN(_data[i].value))
+        _line.append(QPointF((_data[i].key-_stripKey)*scale,
+                             valueAxis->coordToPixel(_data[i].value)-rect.top()));
+    }
+    QCPPainter strip(&_strip);
+    applyDefaultAntialiasingHint(&strip);
+    strip.setPen(mainPen());
+    strip.setBrush(Qt::NoBrush);
+    strip.drawPolyline(_line.constData(), _line.size());
+    _stripLast = _data[end-1].key;
+  }
+
+  painter->drawPixmap(QPoint(rect.left()-qRound(offset), rect.top()), _strip);
+  return true;
+}
@@ -0,0 +1,116 @@
+#ifndef RINGGRAPH_HH
+#define RINGGRAPH_HH
+
+#include "qcustomplot.hh"
+#include "ringbuffer.hh"
+
+
+/** Line graph of a time series, keeping the data in a contiguous ring buffer.
+ *
+ * @c QCPGraph keeps its data in a map, hence each appended point costs a tree insert and a node
+ * allocation, dropping old points erases nodes one by one, and drawing iterates the tree. This
+ * graph requires the keys to be appended in non-decreasing order (e.g., the time of a live
+ * measurement), which allows to keep the data in a @c RingBuffer. Appending a point and dropping
+ * the oldest one cost amortized O(1) without allocating, the visible range is found by a binary
+ * search. If the visible range holds more than two points per pixel, only the minimum and maximum
+ * of each pixel column get drawn. Like a @c QCPGraph, the area between the graph and another one
+ * with the same keys can be filled (see @c setChannelFillGraph).
+ *
+ * The minimum and maximum value are tracked by monotonic deques, updated as points get appended
+ * and dropped. Hence rescaling the value axis to the data (see @c rescaleValueAxis) costs O(1)
+ * instead of a pass over all points.
+ *
+ * In the scrolling mode (see @c setScrolling), the line gets rendered into an offscreen strip
+ * covering the axis rect. As long as the key range only moves forward and the scales do not
+ * change, the strip gets shifted by the elapsed pixels and only the newly appended points are
+ * rendered into it. Hence the cost of a replot is proportional to the new data rather than to the
+ * length of the time window. Any other change re-renders the strip. */
+class RingGraph : public QCPAbstractPlottable
+{
+  Q_OBJECT
+
+public:
+  /** A point of the graph. */
+  struct Data {
+    double key, value;
+  };
+
+public:
+  /** Constructs an empty graph. Like any plottable, it must be added to the plot (see
+   * @c QCustomPlot::addPlottable), which takes the ownership. */
+  RingGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+  /** Returns the number of points. */
+  size_t size() const;
+  /** Returns the i-th point, oldest first. */
+  const Data &at(size_t i) const;
+
+  /** Appends a point. If the key precedes the key of the last point, the previous points get
+   * removed first, as the binary search and the extrema rely on non-decreasing keys. */
+  void addData(double key, double value);
+  /** Replaces the data by the given points, the keys should be sorted (see @c addData). */
+  void setData(const QVector<double> &keys, const QVector<double> &values);
+  /** Removes all points with a key less than @c key. */
+  void removeDataBefore(double key);
+  virtual void clearData();
+
+  /** Fills the area between this graph and the given one with the brush of this graph, 0 disables
+   * the fill. Both graphs should share the keys. */
+  void setChannelFillGraph(RingGraph *graph);
+
+  /** Returns @c true if the scrolling mode is enabled. */
+  bool scrolling() const;
+  /** Enables the scrolling mode, which suits live plots whose key range follows the data. Applies
+   * to graphs with a horizontal, linear key axis without channel fill only. */
+  void setScrolling(bool enabled);
+
+  virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const;
+
+protected:
+  virtual void draw(QCPPainter *painter);
+  virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
+  virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+  virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+
+  /** Returns the index of the first point with a key not less than @c key. */
+  size_t _lowerBound(double key) const;
+  /** Appends the i-th point (counted since the data was cleared) to the deques of the extrema. */
+  void _pushExtrema(size_t index, double value);
+  /** Assembles the visible part of the graph in pixel coordinates into @c points. */
+  void _visiblePoints(QVector<QPointF> &points) const;
+  /** Draws the graph in the scrolling mode. Returns @c false if the mode does not apply. */
+  bool _drawStrip(QCPPainter *painter);
+
+protected:
+  RingBuffer<Data> _data;
+  /** A candidate of the minimum or maximum value. */
+  struct Extremum {
+    /** Index of the point, counted since the data was cleared. */
+    size_t index;
+    double value;
+  };
+  /** Index of the first point, counted since the data was cleared. */
+  size_t _first;
+  /** Candidates of the minimum (increasing values) and maximum (decreasing values), the first
+   * one is the extremum of the data. */
+  RingBuffer<Extremum> _min, _max;
+  /** The graph bounding the channel fill. */
+  QPointer<RingGraph> _channelFillGraph;
+  /** Buffers of the line and fill polygon, reused by every replot. */
+  QVector<QPointF> _line, _fill;
+
+  /** If @c true, the scrolling mode is enabled. */
+  bool _scrolling;
+  /** The rendered line of the scrolling mode and @c true if it is up to date. */
+  QPixmap _strip;
+  bool _stripValid;
+  /** Key at the left edge of the strip and its scale in pixels per key unit. */
+  double _stripKey, _stripScale;
+  /** Key of the last point rendered into the strip. */
+  double _stripLast;
+  /** Value range and pen the strip was rendered with. */
+  QCPRange _stripValueRange;
+  QPen _stripPen;
+};
+
+#endif // RINGGRAPH_HH
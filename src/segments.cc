@@ -0,0 +1,277 @@
+#include "segments.hh"
+#include "recovery.hh"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+
+
+/** Orders segments by their number. */
+static bool
+precedes(const SegmentedRecording::Segment &a, const SegmentedRecording::Segment &b) {
+  return a.number < b.number;
+}
+
+
+/* ********************************************************************************************* *
+ * SegmentedRecording
+ * ********************************************************************************************* */
+SegmentedRecording::SegmentedRecording()
+  : _maxSize(0), _maxDuration(0), _maxTotalSize(0), _maxAge(0), _segmented(false), _number(0),
+    _start(0)
+{
+  // pass...
+}
+
+void
+SegmentedRecording::setRotation(quint64 maxSize, int64_t maxDuration) {
+  _maxSize = maxSize;
+  _maxDuration = std::max(int64_t(0), maxDuration);
+}
+
+void
+SegmentedRecording::setRetention(quint64 maxTotalSize, int64_t maxAge) {
+  _maxTotalSize = maxTotalSize;
+  _maxAge = std::max(int64_t(0), maxAge);
+}
+
+bool
+SegmentedRecording::isSegmented() const {
+  return _segmented;
+}
+
+QString
+SegmentedRecording::begin(const QString &filename, int64_t now) {
+  QFileInfo info(filename);
+  // The numbers of a recording are never reused within a session, as the files of earlier
+  // segments may still get deleted in the background (see Pruning)
+  int last = ((info.absolutePath() == _directory) && (info.completeBaseName() == _baseName)) ?
+        _number : 0;
+  _directory = info.absolutePath();
+  _baseName  = info.completeBaseName();
+  _suffix    = info.suffix();
+  _segments.clear();
+  _number = last;
+  _start  = now;
+  _segmented = (0 != _maxSize) || (0 != _maxDuration);
+  if (! _segmented) {
+    _current = filename;
+    return _current;
+  }
+  // The segments need a suffix to tell them apart from their sidecar files
+  if (_suffix.isEmpty())
+    _suffix = "txt";
+
+  bool changed = ! _readManifest();
+  if (_segments.size())
+    _number = _segments.last().number;
+
+  // Complete the segments left incomplete by an earlier recording
+  QDir dir(_directory);
+  QString pattern = _baseName + ".*.part." + _suffix;
+  foreach (QString part, dir.entryList(QStringList() << pattern, QDir::Files)) {
+    bool ok;
+    int number = part.mid(_baseName.size()+1).section('.', 0, 0).toInt(&ok);
+    if ((! ok) || (part != (_prefix(number, true) + _suffix)))
+      continue;
+    Segment segment;
+    segment.number = number;
+    segment.start  = QFileInfo(dir.filePath(part)).lastModified().toMSecsSinceEpoch();
+    segment.end    = segment.start;
+    // Truncate the segment after its last complete record or block
+    recoverRecording(dir.filePath(part));
+    segment.size   = _complete(number);
+    _segments.append(segment);
+    _number = std::max(_number, number);
+    changed = true;
+    qDebug() << "Completed segment" << dir.filePath(_prefix(number, false) + _suffix);
+  }
+  std::sort(_segments.begin(), _segments.end(), precedes);
+
+  // Continue after the last segment on disk, the manifest may be lost or pruned empty
+  foreach (QString file, dir.entryList(QStringList() << (_baseName + ".*"), QDir::Files)) {
+    bool ok;
+    int number = file.mid(_baseName.size()+1).section('.', 0, 0).toInt(&ok);
+    if (ok && file.startsWith(_prefix(number, false)))
+      _number = std::max(_number, number);
+  }
+  _number = std::max(_number, last);
+
+  if (changed)
+    _writeManifest();
+  _prune(now);
+  _current = _fileName(++_number, true);
+  return _current;
+}
+
+bool
+SegmentedRecording::due(int64_t now, quint64 size) const {
+  return _segmented && (! _current.isEmpty()) &&
+      (((0 != _maxSize) && (size >= _maxSize)) ||
+       ((0 != _maxDuration) && ((now - _start) >= _maxDuration)));
+}
+
+QString
+SegmentedRecording::rotate(int64_t now) {
+  finish(now);
+  _current = _fileName(++_number, true);
+  _start = now;
+  return _current;
+}
+
+void
+SegmentedRecording::finish(int64_t now) {
+  if ((! _segmented) || _current.isEmpty()) {
+    _current.clear();
+    return;
+  }
+
+  Segment segment;
+  segment.number = _number;
+  segment.start  = _start;
+  segment.end    = now;
+  segment.size   = _complete(_number);
+  // A segment that could not be created has no files
+  if (segment.size)
+    _segments.append(segment);
+  _current.clear();
+  _writeManifest();
+  _prune(now);
+}
+
+const QString &
+SegmentedRecording::current() const {
+  return _current;
+}
+
+const QVector<SegmentedRecording::Segment> &
+SegmentedRecording::segments() const {
+  return _segments;
+}
+
+QString
+SegmentedRecording::_prefix(int number, bool part) const {
+  return _baseName + "." + QString("%1").arg(number, 4, 10, QChar('0')) + (part ? ".part." : ".");
+}
+
+QString
+SegmentedRecording::_fileName(int number, bool part) const {
+  return QDir(_directory).filePath(_prefix(number, part) + _suffix);
+}
+
+quint64
+SegmentedRecording::_complete(int number) const {
+  QDir dir(_directory);
+  QString prefix = _prefix(number, true), target = _prefix(number, false);
+  QStringList files = dir.entryList(QStringList() << (prefix + "*"), QDir::Files);
+  // The segment itself gets renamed last, as its name marks the segment as complete
+  QString main = prefix + _suffix;
+  if (files.removeAll(main))
+    files.append(main);
+
+  quint64 size = 0;
+  foreach (QString file, files) {
+    QString name = target + file.mid(prefix.size());
+    // Never replace the files of a complete segment, keep the incomplete ones instead
+    if (dir.exists(name)) {
+      qDebug() << "Cannot complete" << dir.filePath(file) << ":" << name << "exists.";
+      name = file;
+    } else if (! dir.rename(file, name)) {
+      qDebug() << "Cannot rename" << dir.filePath(file) << "to" << name;
+      name = file;
+    }
+    size += QFileInfo(dir.filePath(name)).size();
+  }
+  return size;
+}
+
+bool
+SegmentedRecording::_readManifest() {
+  QFile file(QDir(_directory).filePath(_baseName + ".manifest.tsv"));
+  if (! file.open(QIODevice::ReadOnly))
+    return false;
+  while (! file.atEnd()) {
+    QList<QByteArray> row = file.readLine().trimmed().split('\t');
+    if ((row.size() < 4) || row.first().startsWith('#'))
+      continue;
+    bool ok;
+    Segment segment;
+    QString name = QString::fromUtf8(row[0]);
+    segment.number = name.mid(_baseName.size()+1).section('.', 0, 0).toInt(&ok);
+    segment.start  = row[1].toLongLong();
+    segment.end    = row[2].toLongLong();
+    segment.size   = row[3].toULongLong();
+    if (ok)
+      _segments.append(segment);
+  }
+  std::sort(_segments.begin(), _segments.end(), precedes);
+  return true;
+}
+
+bool
+SegmentedRecording::_writeManifest() const {
+  // QSaveFile replaces the manifest atomically on commit
+  QSaveFile file(QDir(_directory).filePath(_baseName + ".manifest.tsv"));
+  if (! file.open(QIODevice::WriteOnly)) {
+    qDebug() << "Cannot write manifest" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  file.write("#SEGMENT\tSTART\tEND\tBYTES\n");
+  foreach (const Segment &segment, _segments) {
+    file.write((_prefix(segment.number, false) + _suffix).toUtf8()); file.write("\t");
+    file.write(QByteArray::number(qint64(segment.start))); file.write("\t");
+    file.write(QByteArray::number(qint64(segment.end))); file.write("\t");
+    file.write(QByteArray::number(segment.size)); file.write("\n");
+  }
+  return file.commit();
+}
+
+void
+SegmentedRecording::_prune(int64_t now) {
+  quint64 total = 0;
+  foreach (const Segment &segment, _segments)
+    total += segment.size;
+
+  QStringList prefixes;
+  while (_segments.size() &&
+         (((0 != _maxTotalSize) && (total > _maxTotalSize)) ||
+          ((0 != _maxAge) && ((now - _segments.first().end) > _maxAge)))) {
+    prefixes.append(_prefix(_segments.first().number, false));
+    total -= _segments.first().size;
+    _segments.removeFirst();
+  }
+  if (prefixes.isEmpty())
+    return;
+
+  // Drop the segments from the manifest before deleting them
+  _writeManifest();
+  QThreadPool::globalInstance()->start(new Pruning(_directory, prefixes));
+}
+
+
+/* ********************************************************************************************* *
+ * SegmentedRecording::Pruning
+ * ********************************************************************************************* */
+SegmentedRecording::Pruning::Pruning(const QString &directory, const QStringList &prefixes)
+  : QRunnable(), _directory(directory), _prefixes(prefixes)
+{
+  // pass...
+}
+
+void
+SegmentedRecording::Pruning::run() {
+  QDir dir(_directory);
+  foreach (QString prefix, _prefixes) {
+    foreach (QString file, dir.entryList(QStringList() << (prefix + "*"), QDir::Files)) {
+      // The pattern matches the files of an incomplete segment of the same number too
+      if (file.startsWith(prefix + "part."))
+        continue;
+      if (! dir.remove(file))
+        qDebug() << "Cannot delete segment file" << dir.filePath(file);
+    }
+  }
+}
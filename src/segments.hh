@@ -0,0 +1,116 @@
+#ifndef SEGMENTS_HH
+#define SEGMENTS_HH
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QRunnable>
+#include <cinttypes>
+
+
+/** Splits a continuous recording into segments.
+ *
+ * A recording to "name.ext" gets written as the segments "name.0001.ext", "name.0002.ext", ...,
+ * each started once the previous one reached the maximum size or duration. While being written,
+ * a segment and its sidecar files (e.g., its time index) carry the infix ".part" (e.g.,
+ * "name.0001.part.ext"). Once complete, they get renamed, the segment itself last, hence a segment
+ * without the infix is always complete. The complete segments are listed in the manifest
+ * "name.manifest.tsv", which gets replaced atomically on every change. The oldest segments get
+ * deleted (in the background) once the segments exceed the maximum total size or age. If there
+ * is neither a maximum size nor a maximum duration, the recording is written to "name.ext" as
+ * a single file. Such a file carries no infix, hence it does not get recovered by the next
+ * recording after a crash; it must be recovered explicitly (see @c recoverRecording, e.g.,
+ * "pulse-analyze --recover"). */
+class SegmentedRecording
+{
+public:
+  /** A complete segment. */
+  struct Segment {
+    /** Number of the segment. */
+    int number;
+    /** Time of the start and end of the segment in ms since epoch (UTC). */
+    int64_t start, end;
+    /** Size of the segment including its sidecar files in bytes. */
+    quint64 size;
+  };
+
+public:
+  SegmentedRecording();
+
+  /** Sets the maximum size (in bytes) and duration (in ms) of the segments, 0 disables the
+   * respective limit. Applies to recordings started afterwards. */
+  void setRotation(quint64 maxSize, int64_t maxDuration);
+  /** Sets the maximum total size (in bytes) and age (in ms) of the complete segments, 0 disables
+   * the respective limit. */
+  void setRetention(quint64 maxTotalSize, int64_t maxAge);
+
+  /** Returns @c true if the current recording gets split into segments. */
+  bool isSegmented() const;
+  /** Starts a recording to the given file at time @c now (in ms since epoch) and returns the
+   * filename of the first segment. Segments left incomplete by an earlier recording to the same
+   * file (e.g., after a crash) get recovered (see @c recoverRecording) and completed, the
+   * recording continues with a new segment. Its number follows the highest one in the manifest
+   * or the directory (and of earlier recordings to the same file), hence no number gets reused
+   * even if all segments were pruned or the manifest got lost. */
+  QString begin(const QString &filename, int64_t now);
+  /** Returns @c true if the current segment of the given size (in bytes) is complete. */
+  bool due(int64_t now, quint64 size) const;
+  /** Completes the current segment and returns the filename of the next one. The files of the
+   * current segment must be closed. */
+  QString rotate(int64_t now);
+  /** Completes the current segment and ends the recording. The files of the current segment must
+   * be closed. */
+  void finish(int64_t now);
+
+  /** Returns the filename of the current segment. */
+  const QString &current() const;
+  /** Returns the complete segments. */
+  const QVector<Segment> &segments() const;
+
+protected:
+  /** Returns the prefix of the files of the given segment (optionally incomplete). */
+  QString _prefix(int number, bool part) const;
+  /** Returns the filename of the given segment (optionally incomplete). */
+  QString _fileName(int number, bool part) const;
+  /** Renames the files of the given incomplete segment, returns their total size. Existing files
+   * (of a complete segment) never get replaced, the incomplete files are kept instead. */
+  quint64 _complete(int number) const;
+  /** Reads the manifest, returns @c false if there is none. */
+  bool _readManifest();
+  /** Replaces the manifest. */
+  bool _writeManifest() const;
+  /** Drops the oldest segments exceeding the retention limits, their files are deleted in the
+   * background. */
+  void _prune(int64_t now);
+
+protected:
+  /** Deletes the files of the given complete segments (never those of incomplete ones). */
+  class Pruning: public QRunnable
+  {
+  public:
+    Pruning(const QString &directory, const QStringList &prefixes);
+    void run();
+
+  protected:
+    QString _directory;
+    QStringList _prefixes;
+  };
+
+protected:
+  quint64 _maxSize;
+  int64_t _maxDuration;
+  quint64 _maxTotalSize;
+  int64_t _maxAge;
+  /** If @c true, the current recording gets split into segments. */
+  bool _segmented;
+  /** Directory, base name and suffix of the recording. */
+  QString _directory, _baseName, _suffix;
+  /** Number, filename and start time of the current segment. */
+  int _number;
+  QString _current;
+  int64_t _start;
+  /** The complete segments, oldest first. */
+  QVector<Segment> _segments;
+};
+
+#endif // SEGMENTS_HH
@@ -1,5 +1,6 @@
 #include "settings.hh"
 #include <cmath>
+#include <algorithm>
 
 
 Settings::Settings(QObject *parent)
@@ -13,9 +14,20 @@ Settings::Settings(QObject *parent)
   _maxPulse     = value("maxPulse", 150.).toDouble();
   _pulsePlotVisible = value("pulsePlotVisible", false).toBool();
   _pulsePlotDuration = value("pulsePlotDuration", 1.).toDouble();
+  _maxFps = value("maxFps", 30.).toDouble();
   _pulseBeepEnabled = value("pulseBeepEnabled", false).toBool();
   _pulseBeepVolume = value("pulseBeepVolume", 1.0).toDouble();
   _swapChannels = value("swapChannels", false).toBool();
+  _medianDC = value("medianDC", false).toBool();
+  _calibrationFile = value("calibrationFile", "").toString();
+  _logSyncInterval = value("logSyncInterval", 10.).toDouble();
+  QByteArray delimiter = value("logDelimiter", "\t").toString().toLatin1();
+  _logDelimiter = (("," == delimiter) || (";" == delimiter)) ? delimiter.at(0) : '\t';
+  _logPrecision = value("logPrecision", 0).toInt();
+  _logSegmentSize = value("logSegmentSize", 0.).toDouble();
+  _logSegmentDuration = value("logSegmentDuration", 0.).toDouble();
+  _logRetentionSize = value("logRetentionSize", 0.).toDouble();
+  _logRetentionAge = value("logRetentionAge", 0.).toDouble();
 }
 
 
@@ -96,6 +108,17 @@ Settings::setPulsePlotDuration(double dur) {
   setValue("pulsePlotDuration", _pulsePlotDuration);
 }
 
+double
+Settings::maxFps() const {
+  return _maxFps;
+}
+
+void
+Settings::setMaxFps(double fps) {
+  _maxFps = std::max(1., std::min(240., fps));
+  setValue("maxFps", _maxFps);
+}
+
 bool
 Settings::pulseBeepEnabled() const {
   return _pulseBeepEnabled;
@@ -127,3 +150,102 @@ void
 Settings::setSwapChannels(bool swap) {
   _swapChannels = swap;
 }
+
+bool
+Settings::medianDC() const {
+  return _medianDC;
+}
+
+void
+Settings::setMedianDC(bool enabled) {
+  _medianDC = enabled;
+  setValue("medianDC", _medianDC);
+}
+
+QString
+Settings::calibrationFile() const {
+  return _calibrationFile;
+}
+
+void
+Settings::setCalibrationFile(const QString &filename) {
+  _calibrationFile = filename;
+  setValue("calibrationFile", _calibrationFile);
+}
+
+double
+Settings::logSyncInterval() const {
+  return _logSyncInterval;
+}
+
+void
+Settings::setLogSyncInterval(double interval) {
+  _logSyncInterval = std::max(0., interval);
+  setValue("logSyncInterval", _logSyncInterval);
+}
+
+char
+Settings::logDelimiter() const {
+  return _logDelimiter;
+}
+
+void
+Settings::setLogDelimiter(char delimiter) {
+  _logDelimiter = ((',' == delimiter) || (';' == delimiter)) ? delimiter : '\t';
+  setValue("logDelimiter", QString(QLatin1Char(_logDelimiter)));
+}
+
+int
+Settings::logPrecision() const {
+  return _logPrecision;
+}
+
+void
+Settings::setLogPrecision(int precision) {
+  _logPrecision = std::max(0, std::min(17, precision));
+  setValue("logPrecision", _logPrecision);
+}
+
+double
+Settings::logSegmentSize() const {
+  return _logSegmentSize;
+}
+
+void
+Settings::setLogSegmentSize(double size) {
+  _logSegmentSize = std::max(0., size);
+  setValue("logSegmentSize", _logSegmentSize);
+}
+
+double
+Settings::logSegmentDuration() const {
+  return _logSegmentDuration;
+}
+
+void
+Settings::setLogSegmentDuration(double duration) {
+  _logSegmentDuration = std::max(0., duration);
+  setValue("logSegmentDuration", _logSegmentDuration);
+}
+
+double
+Settings::logRetentionSize() const {
+  return _logRetentionSize;
+}
+
+void
+Settings::setLogRetentionSize(double size) {
+  _logRetentionSize = std::max(0., size);
+  setValue("logRetentionSize", _logRetentionSize);
+}
+
+double
+Settings::logRetentionAge() const {
+  return _logRetentionAge;
+}
+
+void
+Settings::setLogRetentionAge(double age) {
+  _logRetentionAge = std::max(0., age);
+  setValue("logRetentionAge", _logRetentionAge);
+}
@@ -47,6 +47,10 @@ public:
   double pulsePlotDuration() const;
   /** Sets the pulse signal time range. */
   void setPulsePlotDuration(double dur);
+  /** Returns the maximum number of plot updates per second. */
+  double maxFps() const;
+  /** Sets the maximum number of plot updates per second. */
+  void setMaxFps(double fps);
 
   /** Returns @c true if the pulse beep is enabled. */
   bool pulseBeepEnabled() const;
@@ -62,6 +66,49 @@ public:
   /** Swaps the IR and RED channels. */
   void setSwapChannels(bool swap);
 
+  /** Returns @c true if the DC components get extracted by running median filters. */
+  bool medianDC() const;
+  /** Selects the running median (robust against motion artifacts) or the sinc low-pass DC
+   * filters. */
+  void setMedianDC(bool enabled);
+
+  /** Returns the file containing the calibration curves (empty for the default curve). */
+  QString calibrationFile() const;
+  /** Sets the file containing the calibration curves. */
+  void setCalibrationFile(const QString &filename);
+
+  /** Returns the interval in seconds, the logs get synced to the disk (0 leaves it to the OS). */
+  double logSyncInterval() const;
+  /** Sets the interval in seconds, the logs get synced to the disk. */
+  void setLogSyncInterval(double interval);
+
+  /** Returns the field delimiter of text logs. */
+  char logDelimiter() const;
+  /** Sets the field delimiter of text logs, one of tab, ',' or ';'. */
+  void setLogDelimiter(char delimiter);
+  /** Returns the number of significant digits of text logs (0 for the shortest round-trip
+   * representation). */
+  int logPrecision() const;
+  /** Sets the number of significant digits of text logs. */
+  void setLogPrecision(int precision);
+
+  /** Returns the maximum size of a log segment in MB (0 for no limit). */
+  double logSegmentSize() const;
+  /** Sets the maximum size of a log segment in MB. */
+  void setLogSegmentSize(double size);
+  /** Returns the maximum duration of a log segment in hours (0 for no limit). */
+  double logSegmentDuration() const;
+  /** Sets the maximum duration of a log segment in hours. */
+  void setLogSegmentDuration(double duration);
+  /** Returns the maximum total size of the log segments kept in MB (0 for no limit). */
+  double logRetentionSize() const;
+  /** Sets the maximum total size of the log segments kept in MB. */
+  void setLogRetentionSize(double size);
+  /** Returns the maximum age of the log segments kept in days (0 for no limit). */
+  double logRetentionAge() const;
+  /** Sets the maximum age of the log segments kept in days. */
+  void setLogRetentionAge(double age);
+
 protected:
   /** The time range for the SpO2/pulse plot. */
   double _plotDuration;
@@ -77,12 +124,28 @@ protected:
   bool _pulsePlotVisible;
   /** Time range of the pulse signal plot. */
   double _pulsePlotDuration;
+  /** Maximum number of plot updates per second. */
+  double _maxFps;
   /** @c true if pulse beep is enabled. */
   bool _pulseBeepEnabled;
   /** The pulse beep volume. */
   double _pulseBeepVolume;
   /** @c true if IR and RED channels are swaped. */
   bool _swapChannels;
+  /** @c true if the DC components get extracted by running median filters. */
+  bool _medianDC;
+  /** The calibration file. */
+  QString _calibrationFile;
+  /** The log sync interval in seconds. */
+  double _logSyncInterval;
+  /** The field delimiter of text logs. */
+  char _logDelimiter;
+  /** The number of significant digits of text logs. */
+  int _logPrecision;
+  /** The maximum size (MB) and duration (h) of a log segment. */
+  double _logSegmentSize, _logSegmentDuration;
+  /** The maximum total size (MB) and age (days) of the log segments kept. */
+  double _logRetentionSize, _logRetentionAge;
 };
 
 #endif // SETTINGS_HH
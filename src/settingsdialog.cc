@@ -4,6 +4,8 @@
 #include <QDoubleValidator>
 #include <QCheckBox>
 #include <QSlider>
+#include <QComboBox>
+#include <QIntValidator>
 
 #include <QDialogButtonBox>
 #include <QDebug>
@@ -50,6 +52,11 @@ SettingsDialog::SettingsDialog(Settings &settings)
   validator->setBottom(0.1);
   _pulsePlotDuration->setValidator(validator);
 
+  _maxFps = new QLineEdit(QString::number(_settings.maxFps()));
+  _maxFps->setValidator(new QDoubleValidator(1, 240, 1));
+  _maxFps->setToolTip(tr("Maximum number of plot updates per second. The plots get updated less "
+                         "often if drawing takes too long."));
+
   _pulseBeepEnabled = new QCheckBox();
   _pulseBeepEnabled->setChecked(_settings.pulseBeepEnabled());
 
@@ -61,6 +68,60 @@ SettingsDialog::SettingsDialog(Settings &settings)
   _swapChannels = new QCheckBox();
   _swapChannels->setChecked(_settings.swapChannels());
 
+  _medianDC = new QCheckBox();
+  _medianDC->setChecked(_settings.medianDC());
+  _medianDC->setToolTip(tr("Extracts the DC components by running median filters, which are "
+                           "robust against spikes and motion artifacts."));
+
+  _calibrationFile = new QLineEdit(_settings.calibrationFile());
+  _calibrationFile->setPlaceholderText(tr("default (NXP AN4327)"));
+
+  _logSyncInterval = new QLineEdit(QString::number(_settings.logSyncInterval()));
+  validator = new QDoubleValidator();
+  validator->setBottom(0);
+  _logSyncInterval->setValidator(validator);
+  _logSyncInterval->setToolTip(tr("Interval in seconds, the logs get synced to the disk. "
+                                  "0 leaves it to the operating system."));
+
+  _logDelimiter = new QComboBox();
+  _logDelimiter->addItem(tr("Tab"), int('\t'));
+  _logDelimiter->addItem(tr("Comma"), int(','));
+  _logDelimiter->addItem(tr("Semicolon"), int(';'));
+  _logDelimiter->setCurrentIndex(_logDelimiter->findData(int(_settings.logDelimiter())));
+
+  _logPrecision = new QLineEdit(QString::number(_settings.logPrecision()));
+  _logPrecision->setValidator(new QIntValidator(0, 17));
+  _logPrecision->setToolTip(tr("Significant digits of the values in text logs. "
+                               "0 writes the shortest representation of the exact value."));
+
+  _logSegmentSize = new QLineEdit(QString::number(_settings.logSegmentSize()));
+  validator = new QDoubleValidator();
+  validator->setBottom(0);
+  _logSegmentSize->setValidator(validator);
+  _logSegmentSize->setToolTip(tr("Size in MB, at which a new log segment gets started. "
+                                 "0 disables the limit."));
+
+  _logSegmentDuration = new QLineEdit(QString::number(_settings.logSegmentDuration()));
+  validator = new QDoubleValidator();
+  validator->setBottom(0);
+  _logSegmentDuration->setValidator(validator);
+  _logSegmentDuration->setToolTip(tr("Duration in hours, after which a new log segment gets "
+                                     "started. 0 disables the limit."));
+
+  _logRetentionSize = new QLineEdit(QString::number(_settings.logRetentionSize()));
+  validator = new QDoubleValidator();
+  validator->setBottom(0);
+  _logRetentionSize->setValidator(validator);
+  _logRetentionSize->setToolTip(tr("Total size in MB of the log segments kept, the oldest ones "
+                                   "get deleted. 0 keeps all segments."));
+
+  _logRetentionAge = new QLineEdit(QString::number(_settings.logRetentionAge()));
+  validator = new QDoubleValidator();
+  validator->setBottom(0);
+  _logRetentionAge->setValidator(validator);
+  _logRetentionAge->setToolTip(tr("Age in days of the log segments kept, older ones get deleted. "
+                                  "0 keeps all segments."));
+
   QDialogButtonBox *bb = new QDialogButtonBox(QDialogButtonBox::Cancel | QDialogButtonBox::Ok);
 
   QFormLayout *form = new QFormLayout();
@@ -71,9 +132,19 @@ SettingsDialog::SettingsDialog(Settings &settings)
   form->addRow(tr("max. Pulse value"), _maxPulse);
   form->addRow(tr("Pulse signal plot visible"), _pulsePlotVisible);
   form->addRow(tr("Pulse signal time window"), _pulsePlotDuration);
+  form->addRow(tr("max. Plot updates per second"), _maxFps);
   form->addRow(tr("Pulse beep enabled"), _pulseBeepEnabled);
   form->addRow(tr("Pulse beep volume"), _pulseBeepVolume);
   form->addRow(tr("Swap channels"), _swapChannels);
+  form->addRow(tr("Median DC filter"), _medianDC);
+  form->addRow(tr("Calibration file"), _calibrationFile);
+  form->addRow(tr("Log sync interval [s]"), _logSyncInterval);
+  form->addRow(tr("Text log delimiter"), _logDelimiter);
+  form->addRow(tr("Text log precision"), _logPrecision);
+  form->addRow(tr("Log segment size [MB]"), _logSegmentSize);
+  form->addRow(tr("Log segment duration [h]"), _logSegmentDuration);
+  form->addRow(tr("Keep log segments up to [MB]"), _logRetentionSize);
+  form->addRow(tr("Keep log segments for [days]"), _logRetentionAge);
 
   QVBoxLayout *layout = new QVBoxLayout();
   layout->addLayout(form);
@@ -97,9 +168,19 @@ SettingsDialog::apply() {
   _settings.setMaxPulse(_maxPulse->text().toDouble());
   _settings.setPulsePlotVisible(_pulsePlotVisible->isChecked());
   _settings.setPulsePlotDuration(_pulsePlotDuration->text().toDouble());
+  _settings.setMaxFps(_maxFps->text().toDouble());
   _settings.setPulseBeepEnabled(_pulseBeepEnabled->isChecked());
   _settings.setPulseBeepVolume(double(_pulseBeepVolume->value())/100);
   _settings.setSwapChannels(_swapChannels->isChecked());
+  _settings.setMedianDC(_medianDC->isChecked());
+  _settings.setCalibrationFile(_calibrationFile->text());
+  _settings.setLogSyncInterval(_logSyncInterval->text().toDouble());
+  _settings.setLogDelimiter(char(_logDelimiter->currentData().toInt()));
+  _settings.setLogPrecision(_logPrecision->text().toInt());
+  _settings.setLogSegmentSize(_logSegmentSize->text().toDouble());
+  _settings.setLogSegmentDuration(_logSegmentDuration->text().toDouble());
+  _settings.setLogRetentionSize(_logRetentionSize->text().toDouble());
+  _settings.setLogRetentionAge(_logRetentionAge->text().toDouble());
   accept();
 }
 
@@ -8,6 +8,7 @@
 class QLineEdit;
 class QCheckBox;
 class QSlider;
+class QComboBox;
 
 /** Simple dialog to edit the settings. */
 class SettingsDialog: public QDialog
@@ -32,10 +33,20 @@ protected:
   QLineEdit *_maxPulse;
   QCheckBox *_pulsePlotVisible;
   QLineEdit *_pulsePlotDuration;
+  QLineEdit *_maxFps;
   QCheckBox *_pulseBeepEnabled;
   QSlider   *_pulseBeepVolume;
   QSoundEffect _beep;
   QCheckBox *_swapChannels;
+  QCheckBox *_medianDC;
+  QLineEdit *_calibrationFile;
+  QLineEdit *_logSyncInterval;
+  QComboBox *_logDelimiter;
+  QLineEdit *_logPrecision;
+  QLineEdit *_logSegmentSize;
+  QLineEdit *_logSegmentDuration;
+  QLineEdit *_logRetentionSize;
+  QLineEdit *_logRetentionAge;
 };
 
 #endif // SETTINGSDIALOG_HH
@@ -0,0 +1,123 @@
+#include "textrow.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <clocale>
+#include <algorithm>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+// Large enough for any double in any precision up to 17 significant digits
+#define FIELD_SIZE 32
+
+
+/** Formats @c value into @c buffer, returns the number of characters written. @c digits specifies
+ * the number of significant digits that suffice for any value of type T. */
+template <class T>
+static int
+format(T value, int precision, int digits, char *buffer) {
+#if defined(__cpp_lib_to_chars)
+  (void) digits;
+  std::to_chars_result res = (precision > 0)
+      ? std::to_chars(buffer, buffer+FIELD_SIZE, value, std::chars_format::general, precision)
+      : std::to_chars(buffer, buffer+FIELD_SIZE, value);
+  return int(res.ptr - buffer);
+#else
+  int len;
+  if (precision > 0) {
+    len = snprintf(buffer, FIELD_SIZE, "%.*g", precision, double(value));
+  } else {
+    // Shortest round-trip representation, trying fewer digits first
+    for (precision=digits-2; precision<digits; precision++) {
+      len = snprintf(buffer, FIELD_SIZE, "%.*g", precision, double(value));
+      if (value == T(strtod(buffer, 0)))
+        break;
+    }
+    if (digits == precision)
+      len = snprintf(buffer, FIELD_SIZE, "%.*g", digits, double(value));
+  }
+  // snprintf uses the decimal point of the locale
+  char point = localeconv()->decimal_point[0];
+  if ('.' != point)
+    std::replace(buffer, buffer+len, point, '.');
+  return len;
+#endif
+}
+
+
+/* ********************************************************************************************* *
+ * TextRow
+ * ********************************************************************************************* */
+TextRow::TextRow(char delimiter, int precision)
+  : _delimiter(delimiter), _precision(std::max(0, std::min(17, precision))), _line()
+{
+  // Keeps the buffer when the row gets cleared
+  _line.reserve(256);
+}
+
+char
+TextRow::delimiter() const {
+  return _delimiter;
+}
+
+void
+TextRow::setDelimiter(char delimiter) {
+  _delimiter = delimiter;
+}
+
+int
+TextRow::precision() const {
+  return _precision;
+}
+
+void
+TextRow::setPrecision(int precision) {
+  _precision = std::max(0, std::min(17, precision));
+}
+
+void
+TextRow::clear() {
+  _line.resize(0);
+}
+
+void
+TextRow::add(double value) {
+  char buffer[FIELD_SIZE];
+  _separate();
+  _line.append(buffer, format(value, _precision, 17, buffer));
+}
+
+void
+TextRow::add(float value) {
+  char buffer[FIELD_SIZE];
+  _separate();
+  _line.append(buffer, format(value, _precision, 9, buffer));
+}
+
+void
+TextRow::add(int64_t value) {
+  char buffer[FIELD_SIZE], *p = buffer+FIELD_SIZE;
+  uint64_t v = (value < 0) ? (~uint64_t(value) + 1) : uint64_t(value);
+  do {
+    *(--p) = char('0' + v%10);
+    v /= 10;
+  } while (v);
+  if (value < 0)
+    *(--p) = '-';
+  _separate();
+  _line.append(p, int(buffer+FIELD_SIZE-p));
+}
+
+void
+TextRow::add(const char *text) {
+  _separate();
+  _line.append(text);
+}
+
+void
+TextRow::end() {
+  _line.append('\n');
+}
@@ -0,0 +1,64 @@
+#ifndef TEXTROW_HH
+#define TEXTROW_HH
+
+#include <QByteArray>
+#include <cinttypes>
+
+
+/** Assembles a row of a text log (e.g., TSV or CSV) in a reusable line buffer.
+ *
+ * Numbers are formatted directly into the buffer (using @c std::to_chars if available), hence
+ * once the buffer has grown to the size of a row, formatting a row does not allocate. Doubles are
+ * formatted with the shortest representation that reads back to the same value, unless a
+ * precision (number of significant digits) is set. The decimal point is always '.',
+ * independent of the locale. */
+class TextRow
+{
+public:
+  /** Constructor.
+   * @param delimiter Specifies the field delimiter.
+   * @param precision Specifies the number of significant digits, 0 selects the shortest
+   *        round-trip representation. */
+  TextRow(char delimiter='\t', int precision=0);
+
+  /** Returns the field delimiter. */
+  char delimiter() const;
+  /** Sets the field delimiter. */
+  void setDelimiter(char delimiter);
+  /** Returns the number of significant digits, 0 for the shortest round-trip representation. */
+  int precision() const;
+  /** Sets the number of significant digits, 0 selects the shortest round-trip representation. */
+  void setPrecision(int precision);
+
+  /** Starts a new row. */
+  void clear();
+  /** Appends a field holding the given value. */
+  void add(double value);
+  /** Appends a field holding the given value, in the shortest representation of the float. */
+  void add(float value);
+  /** Appends a field holding the given integer. */
+  void add(int64_t value);
+  /** Appends a field holding the given integer. */
+  inline void add(int value) { add(int64_t(value)); }
+  /** Appends a field holding the given text as is. */
+  void add(const char *text);
+  /** Terminates the row. */
+  void end();
+
+  /** Returns the row. */
+  inline const QByteArray &line() const { return _line; }
+
+protected:
+  /** Appends the delimiter unless the row is empty. */
+  inline void _separate() {
+    if (_line.size())
+      _line.append(_delimiter);
+  }
+
+protected:
+  char _delimiter;
+  int _precision;
+  QByteArray _line;
+};
+
+#endif // TEXTROW_HH
@@ -0,0 +1,171 @@
+#include "timeindex.hh"
+#include <QtGlobal>
+#include <QDebug>
+#include <cstring>
+
+#define MAGIC "PULSEIDX"
+
+// The entries are accessed in place, hence they must not contain any padding
+Q_STATIC_ASSERT(sizeof(TimeIndexHeader) == 32);
+Q_STATIC_ASSERT(sizeof(TimeIndexEntry) == 24);
+
+
+/* ********************************************************************************************* *
+ * TimeIndexWriter
+ * ********************************************************************************************* */
+TimeIndexWriter::TimeIndexWriter()
+  : _file(1<<12)
+{
+  // pass...
+}
+
+QString
+TimeIndexWriter::fileName(const QString &recording) {
+  return recording + ".idx";
+}
+
+bool
+TimeIndexWriter::open(const QString &recording, int64_t startTime) {
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  qDebug() << "Time indices are not supported on big-endian hosts.";
+  return false;
+#endif
+  if (! _file.open(fileName(recording)))
+    return false;
+
+  TimeIndexHeader header;
+  memset(&header, 0, sizeof(TimeIndexHeader));
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version    = version;
+  header.headerSize = sizeof(TimeIndexHeader);
+  header.entrySize  = sizeof(TimeIndexEntry);
+  header.startTime  = startTime;
+  return _file.write((const char *)&header, sizeof(TimeIndexHeader));
+}
+
+bool
+TimeIndexWriter::isOpen() const {
+  return _file.isOpen();
+}
+
+bool
+TimeIndexWriter::add(const TimeIndexEntry &entry) {
+  return _file.write((const char *)&entry, sizeof(TimeIndexEntry));
+}
+
+void
+TimeIndexWriter::close() {
+  _file.close();
+}
+
+AsyncWriter &
+TimeIndexWriter::writer() {
+  return _file;
+}
+
+
+/* ********************************************************************************************* *
+ * TimeIndex
+ * ********************************************************************************************* */
+TimeIndex::TimeIndex()
+  : _data(0), _entries(0), _count(0)
+{
+  // pass...
+}
+
+TimeIndex::~TimeIndex() {
+  close();
+}
+
+bool
+TimeIndex::open(const QString &recording, int64_t startTime, uint64_t size) {
+  close();
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+  return false;
+#endif
+  _file.setFileName(TimeIndexWriter::fileName(recording));
+  if (! _file.open(QIODevice::ReadOnly))
+    return false;
+  if ((_file.size() < qint64(sizeof(TimeIndexHeader))) ||
+      (0 == (_data = _file.map(0, _file.size())))) {
+    _file.close();
+    return false;
+  }
+
+  const TimeIndexHeader &hdr = *reinterpret_cast<const TimeIndexHeader *>(_data);
+  if ((0 != memcmp(hdr.magic, MAGIC, sizeof(hdr.magic))) || (0 == hdr.version) ||
+      (hdr.headerSize != sizeof(TimeIndexHeader)) || (hdr.entrySize != sizeof(TimeIndexEntry)) ||
+      (hdr.startTime != startTime)) {
+    qDebug() << "Ignore invalid or outdated index" << _file.fileName();
+    close();
+    return false;
+  }
+  _entries = reinterpret_cast<const TimeIndexEntry *>(_data + hdr.headerSize);
+  _count   = (_file.size() - hdr.headerSize)/sizeof(TimeIndexEntry);
+  // The index may be ahead of the recording (e.g., after a crash), drop the trailing entries
+  while (_count && (_entries[_count-1].offset >= size))
+    _count--;
+  return true;
+}
+
+void
+TimeIndex::close() {
+  if (_data)
+    _file.unmap(_data);
+  _file.close();
+  _data = 0; _entries = 0; _count = 0;
+  _tail.clear();
+}
+
+size_t
+TimeIndex::size() const {
+  return _count + _tail.size();
+}
+
+const TimeIndexEntry &
+TimeIndex::last() const {
+  return entry(size()-1);
+}
+
+void
+TimeIndex::append(const TimeIndexEntry &entry) {
+  _tail.append(entry);
+}
+
+void
+TimeIndex::resize(size_t n) {
+  if (n < _count) {
+    _count = n;
+    _tail.clear();
+  } else if (n < size()) {
+    _tail.resize(n-_count);
+  }
+}
+
+size_t
+TimeIndex::findTime(uint32_t t) const {
+  // First entry whose last sample is not before t
+  size_t lo = 0, hi = size();
+  while (lo < hi) {
+    size_t mid = (lo+hi)/2;
+    if (entry(mid).tLast < t)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+size_t
+TimeIndex::findRow(uint64_t row) const {
+  // Last entry starting at or before the row
+  size_t lo = 0, hi = size();
+  while (lo < hi) {
+    size_t mid = (lo+hi)/2;
+    if (entry(mid).row <= row)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo ? (lo-1) : 0;
+}
@@ -0,0 +1,125 @@
+#ifndef TIMEINDEX_HH
+#define TIMEINDEX_HH
+
+#include <QString>
+#include <QFile>
+#include <QVector>
+#include "asyncwriter.hh"
+#include <cinttypes>
+
+
+/** Header of a time index.
+ *
+ * A time index is a sidecar file next to a recording (with the additional extension .idx). It
+ * holds a sparse list of entries, each locating a run of samples in the recording by its file
+ * offset, the index of its first sample and its time range. Hence a reader can locate any point in
+ * time by a binary search over the entries, without scanning the recording. All values are stored
+ * in little-endian byte order. */
+struct TimeIndexHeader
+{
+  /** Magic bytes "PULSEIDX". */
+  char     magic[8];
+  /** Format version. */
+  uint16_t version;
+  /** Size of the header in bytes. */
+  uint16_t headerSize;
+  /** Size of each entry in bytes. */
+  uint16_t entrySize;
+  uint16_t reserved0;
+  /** Start time of the indexed recording in ms since epoch (UTC), identifies the recording. */
+  int64_t  startTime;
+  uint8_t  reserved[8];
+};
+
+
+/** An entry of the time index. */
+struct TimeIndexEntry
+{
+  /** File offset of the first sample in bytes. */
+  uint64_t offset;
+  /** Index of the first sample. */
+  uint64_t row;
+  /** Time of the first and last sample in ms since the start of the recording. */
+  uint32_t tFirst, tLast;
+};
+
+
+/** Writes the time index of a recording along with it. The writers of the binary recording
+ * formats add an entry for every run of samples written. */
+class TimeIndexWriter
+{
+public:
+  /** Current format version. */
+  const static uint16_t version = 1;
+
+public:
+  TimeIndexWriter();
+
+  /** Returns the filename of the index of the given recording. */
+  static QString fileName(const QString &recording);
+
+  /** Creates the index of the given recording. Returns @c false on error. */
+  bool open(const QString &recording, int64_t startTime);
+  /** Returns @c true if an index is open. */
+  bool isOpen() const;
+  /** Appends an entry. */
+  bool add(const TimeIndexEntry &entry);
+  /** Closes the index. */
+  void close();
+
+  /** Returns the writer (e.g., to set the sync policy). */
+  AsyncWriter &writer();
+
+protected:
+  AsyncWriter _file;
+};
+
+
+/** Reader of a time index.
+ *
+ * The index gets mapped into memory, hence opening costs constant time. The entries are sorted by
+ * time, searching costs O(log n). The reader of the recording may append entries for the samples
+ * following the last indexed run (e.g., after a crash or if there is no index at all). */
+class TimeIndex
+{
+public:
+  TimeIndex();
+  ~TimeIndex();
+
+  /** Maps the index of the given recording. Entries located beyond @c size bytes of the recording
+   * are ignored. Returns @c false if there is no valid index for the recording with the given
+   * start time. */
+  bool open(const QString &recording, int64_t startTime, uint64_t size);
+  /** Unmaps the index and drops all entries. */
+  void close();
+
+  /** Returns the number of entries. */
+  size_t size() const;
+  /** Returns the i-th entry. */
+  inline const TimeIndexEntry &entry(size_t i) const {
+    return (i < _count) ? _entries[i] : _tail[i-_count];
+  }
+  /** Returns the last entry, the index must not be empty. */
+  const TimeIndexEntry &last() const;
+  /** Appends an entry, which must not precede the last one. */
+  void append(const TimeIndexEntry &entry);
+  /** Drops all but the first @c n entries. */
+  void resize(size_t n);
+
+  /** Returns the index of the entry holding the first sample at or after time @c t (in ms). If
+   * all samples precede @c t, the number of entries is returned. */
+  size_t findTime(uint32_t t) const;
+  /** Returns the index of the entry holding the given sample. The index must not be empty. */
+  size_t findRow(uint64_t row) const;
+
+protected:
+  QFile _file;
+  uchar *_data;
+  /** The mapped entries. */
+  const TimeIndexEntry *_entries;
+  size_t _count;
+  /** Entries appended by the reader. */
+  QVector<TimeIndexEntry> _tail;
+};
+
+#endif // TIMEINDEX_HH
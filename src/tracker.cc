@@ -0,0 +1,112 @@
+#include "tracker.hh"
+#include <cmath>
+#include <algorithm>
+
+
+const TrendTracker::Map TrendTracker::_identity = { 0, 1, 0, 1 };
+
+TrendTracker::TrendTracker(double q, double r, uint16_t lag, double x0, double p0)
+  : _q(q), _r(r), _lag(std::max(uint16_t(1), std::min(lag, uint16_t(maxLag-1))))
+{
+  reset(x0, p0);
+}
+
+void
+TrendTracker::reset(double x0, double p0) {
+  _idx = 0; _count = 1;
+  _history[0].xp = _history[0].x = x0;
+  _history[0].Pp = _history[0].P = p0;
+  _frontCount = _backCount = 0;
+  _back = _identity;
+}
+
+void
+TrendTracker::predict(double dt) {
+  uint16_t lastIdx = _idx;
+  const State &last = _history[lastIdx];
+  _idx = (_idx+1) % maxLag;
+  State &next = _history[_idx];
+  next.xp = next.x = last.x;
+  next.Pp = next.P = last.P + _q*std::max(0., dt);
+
+  // Drop the map of the oldest step if the window is full
+  if (_count > _lag) {
+    if (0 == _frontCount) {
+      // Move the newer maps to the older ones, composing them from the newest on
+      uint16_t k = lastIdx;
+      for (uint16_t i=0; i<_backCount; i++) {
+        k = (k+maxLag-1) % maxLag;
+        _front[k] = (0 == i) ? _maps[k] : _compose(_maps[k], _front[(k+1) % maxLag]);
+      }
+      _frontCount = _backCount;
+      _backCount = 0;
+      _back = _identity;
+    }
+    _frontCount--;
+  } else {
+    _count++;
+  }
+
+  // Backward map of the last step, fixed by the prediction of the next one
+  double C = (next.Pp > 0) ? last.P/next.Pp : 0;
+  Map &map = _maps[lastIdx];
+  map.cx = last.x - C*next.xp; map.mx = C;
+  map.cP = last.P - C*C*next.Pp; map.mP = C*C;
+  _back = _compose(_back, map);
+  _backCount++;
+}
+
+void
+TrendTracker::update(double z, double quality) {
+  if ((quality <= 0) || (! std::isfinite(z)))
+    return;
+  State &state = _history[_idx];
+  double R = _r/(quality*quality);
+  double K = state.P/(state.P + R);
+  state.x += K*(z-state.x);
+  state.P *= (1-K);
+}
+
+double
+TrendTracker::value() const {
+  return _history[_idx].x;
+}
+
+double
+TrendTracker::variance() const {
+  return _history[_idx].P;
+}
+
+double
+TrendTracker::stdDev() const {
+  return std::sqrt(variance());
+}
+
+uint16_t
+TrendTracker::lag() const {
+  return _lag;
+}
+
+double
+TrendTracker::smoothedValue() const {
+  double x, P;
+  _smooth(x, P);
+  return x;
+}
+
+double
+TrendTracker::smoothedVariance() const {
+  double x, P;
+  _smooth(x, P);
+  return P;
+}
+
+void
+TrendTracker::_smooth(double &x, double &P) const {
+  // Rauch-Tung-Striebel backward pass from the current step
+  Map map = _back;
+  if (_frontCount)
+    map = _compose(_front[(_idx+maxLag-_count+1) % maxLag], _back);
+  x = map.cx + map.mx*_history[_idx].x;
+  P = map.cP + map.mP*_history[_idx].P;
+}
@@ -0,0 +1,110 @@
+#ifndef TRACKER_HH
+#define TRACKER_HH
+
+#include <cinttypes>
+
+
+/** A scalar Kalman filter and fixed-lag smoother for slowly varying trends (e.g., pulse rate).
+ *
+ * The trend is modeled as a random walk with the process noise @c q per time unit. Measurements
+ * have the noise variance @c r/quality^2, i.e., measurements of low signal quality are trusted
+ * less. Without measurements, the trend is only predicted and its variance grows. The filter
+ * states are kept for the last @c lag steps.
+ *
+ * Each step of the Rauch-Tung-Striebel backward pass maps the smoothed estimate of a step to the
+ * one of the preceding step by an affine map, which is fixed once the next step got predicted.
+ * The smoothed estimate @c lag steps ago is the composition of the last @c lag maps applied to the
+ * current estimate. This composition is maintained over the sliding window by two stacks (the
+ * suffix compositions of the older maps and the composition of the newer ones), hence a step and
+ * the smoothed estimate cost amortized constant time instead of a backward pass over the lag. */
+class TrendTracker
+{
+public:
+  /// Maximum lag of the smoother in steps.
+  const static uint16_t maxLag = 256;
+
+public:
+  /** Constructor.
+   * @param q Specifies the process noise variance per time unit.
+   * @param r Specifies the measurement noise variance (at perfect signal quality).
+   * @param lag Specifies the lag of the smoother in steps.
+   * @param x0 Specifies the initial value.
+   * @param p0 Specifies the initial variance. */
+  TrendTracker(double q, double r, uint16_t lag, double x0, double p0);
+
+  /** Resets the tracker to the given initial value and variance. */
+  void reset(double x0, double p0);
+
+  /** Starts a new step and predicts the trend @c dt time units ahead. */
+  void predict(double dt);
+  /** Updates the current step with the measurement @c z of the given signal quality in (0,1]. */
+  void update(double z, double quality=1);
+
+  /** Returns the current (filtered) estimate. */
+  double value() const;
+  /** Returns the variance of the current estimate. */
+  double variance() const;
+  /** Returns the standard deviation of the current estimate. */
+  double stdDev() const;
+
+  /** Returns the lag of the smoother in steps. */
+  uint16_t lag() const;
+  /** Returns the smoothed estimate of the step @c lag steps ago (or of the first step if there
+   * are fewer steps). */
+  double smoothedValue() const;
+  /** Returns the variance of the smoothed estimate. */
+  double smoothedVariance() const;
+
+protected:
+  /** Runs the fixed-lag smoother, i.e. applies the composed maps to the current step. */
+  void _smooth(double &x, double &P) const;
+
+protected:
+  /** Filter state of a single step. */
+  typedef struct {
+    /** Predicted estimate and variance. */
+    double xp, Pp;
+    /** Filtered estimate and variance. */
+    double x, P;
+  } State;
+
+  /** Affine maps of the smoothed estimate and variance, i.e. x -> cx + mx*x, P -> cP + mP*P. */
+  typedef struct {
+    double cx, mx;
+    double cP, mP;
+  } Map;
+
+  /** The identity map. */
+  static const Map _identity;
+
+  /** Returns the composition of the given maps, @c b gets applied first. */
+  static inline Map _compose(const Map &a, const Map &b) {
+    Map ab = { a.cx + a.mx*b.cx, a.mx*b.mx, a.cP + a.mP*b.cP, a.mP*b.mP };
+    return ab;
+  }
+  /** Process noise variance per time unit. */
+  double _q;
+  /** Measurement noise variance. */
+  double _r;
+  /** Lag of the smoother. */
+  uint16_t _lag;
+  /** Ring buffer of the last steps. */
+  State _history[maxLag];
+  /** Index of the current step in the history. */
+  uint16_t _idx;
+  /** Number of steps in the history. */
+  uint16_t _count;
+  /** Backward maps of the steps in the history, except for the current one. */
+  Map _maps[maxLag];
+  /** Compositions of the older maps of the window, from the map of the step to the last older
+   * one. */
+  Map _front[maxLag];
+  /** Number of older maps. */
+  uint16_t _frontCount;
+  /** Composition of the newer maps of the window. */
+  Map _back;
+  /** Number of newer maps. */
+  uint16_t _backCount;
+};
+
+#endif // TRACKER_HH